@@ -0,0 +1,101 @@
+#include "asset_pool.hpp"
+
+#include <string>
+
+//
+// AssetJobPool
+//
+
+AssetJobPool::AssetJobPool(unsigned int nThreads)
+: isStopping_(false)
+{
+    if (nThreads == 0)
+        nThreads = 1;
+
+    for (unsigned int i = 0; i < nThreads; i++)
+        workers_.emplace_back(&AssetJobPool::workerLoop, this);
+}
+
+AssetJobPool::~AssetJobPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isStopping_ = true;
+    }
+    condition_.notify_all();
+
+    for (std::thread& worker : workers_)
+        worker.join();
+}
+
+void AssetJobPool::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]() { return isStopping_ || !jobs_.empty(); });
+            if (jobs_.empty())
+                return;
+
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        job();
+    }
+}
+
+//
+// AssetLoader
+//
+
+AssetLoader::AssetLoader(AssetJobPool& pool)
+: pool_(pool)
+{
+
+}
+
+void AssetLoader::addModel(Model& model, const char* path)
+{
+    models_.push_back({ &model, pool_.submit([path]() { return Model::prepare(path); }) });
+}
+
+void AssetLoader::addTexture(Texture2D& texture, const char* path)
+{
+    textures_.push_back({ &texture, pool_.submit([path]() { return decodeImage(path, true); }) });
+}
+
+void AssetLoader::addCubeMap(TextureCubeMap& texture, const char** pathes)
+{
+    CubeMapJob& job = cubeMaps_.emplace_back();
+    job.texture = &texture;
+    for (unsigned int i = 0; i < 6; i++)
+    {
+        std::string path = pathes[i];
+        job.faces[i] = pool_.submit([path]() { return decodeImage(path.c_str(), false); });
+    }
+}
+
+void AssetLoader::finish()
+{
+    // Chaque get() attend seulement la tâche concernée, les autres continuent
+    // de se décoder pendant les envois précédents.
+    for (TextureJob& job : textures_)
+        job.texture->load(job.image.get());
+
+    for (CubeMapJob& job : cubeMaps_)
+    {
+        ImageData faces[6];
+        for (unsigned int i = 0; i < 6; i++)
+            faces[i] = job.faces[i].get();
+        job.texture->load(faces);
+    }
+
+    for (ModelJob& job : models_)
+        job.model->load(job.staging.get());
+
+    models_.clear();
+    textures_.clear();
+    cubeMaps_.clear();
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "model.hpp"
+#include "textures.hpp"
+
+// Bassin de threads pour le décodage des ressources (images, maillages).
+// Les tâches ne doivent faire aucun appel OpenGL.
+class AssetJobPool
+{
+public:
+    explicit AssetJobPool(unsigned int nThreads = std::thread::hardware_concurrency());
+    ~AssetJobPool();
+
+    AssetJobPool(const AssetJobPool&) = delete;
+    AssetJobPool& operator=(const AssetJobPool&) = delete;
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& job)
+    {
+        using Result = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.emplace_back([task]() { (*task)(); });
+        }
+        condition_.notify_one();
+        return result;
+    }
+
+private:
+    void workerLoop();
+
+private:
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> jobs_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool isStopping_;
+};
+
+
+// Soumet le décodage des ressources au bassin, puis fait seulement les envois
+// OpenGL (glTexImage2D, glBufferData) sur le thread appelant dans finish().
+class AssetLoader
+{
+public:
+    explicit AssetLoader(AssetJobPool& pool);
+
+    void addModel(Model& model, const char* path);
+    void addTexture(Texture2D& texture, const char* path);
+    void addCubeMap(TextureCubeMap& texture, const char** pathes);
+
+    void finish();
+
+private:
+    struct ModelJob
+    {
+        Model* model;
+        std::future<ModelStaging> staging;
+    };
+
+    struct TextureJob
+    {
+        Texture2D* texture;
+        std::future<ImageData> image;
+    };
+
+    struct CubeMapJob
+    {
+        TextureCubeMap* texture;
+        std::future<ImageData> faces[6];
+    };
+
+    AssetJobPool& pool_;
+    std::vector<ModelJob> models_;
+    std::vector<TextureJob> textures_;
+    std::vector<CubeMapJob> cubeMaps_;
+};
@@ -6,32 +6,56 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include <map>
-
-#include "shaders.hpp"
+#include "asset_pool.hpp"
+#include "light_manager.hpp"
+#include "render_queue.hpp"
+#include "transform_ring.hpp"
 
 
 using namespace gl;
 using namespace glm;
 
-struct Material
+const glm::vec3 WHEEL_POSITIONS[] =
 {
-    glm::vec4 emission; // vec3, but padded
-    glm::vec4 ambient;  // vec3, but padded
-    glm::vec4 diffuse;  // vec3, but padded
-    glm::vec3 specular;
-    GLfloat shininess;
+    glm::vec3(-1.29f, 0.245f, -0.57f),
+    glm::vec3(-1.29f, 0.245f,  0.57f),
+    glm::vec3( 1.4f , 0.245f, -0.57f),
+    glm::vec3( 1.4f , 0.245f,  0.57f)
 };
-    
+
+const glm::vec3 HEADLIGHT_POSITIONS[] =
+{
+    glm::vec3(-2.0019f, 0.64f, -0.45f),
+    glm::vec3(-2.0019f, 0.64f,  0.45f),
+    glm::vec3( 2.0019f, 0.64f, -0.45f),
+    glm::vec3( 2.0019f, 0.64f,  0.45f)
+};
+
+const glm::vec3 WINDOW_POSITION[] =
+{
+    glm::vec3(-0.813, 0.755, 0.0),
+    glm::vec3(1.092, 0.761, 0.0),
+    glm::vec3(-0.3412, 0.757, 0.51),
+    glm::vec3(-0.3412, 0.757, -0.51),
+    glm::vec3(0.643, 0.756, 0.508),
+    glm::vec3(0.643, 0.756, -0.508)
+};
+
+const float LIGHT_Z_POS = 0.029f;
+const float BLINKER_Z_POS = -0.06065f;
+
 Car::Car()
 : position(0.0f, 0.0f, 0.0f), orientation(0.0f, 0.0f), speed(0.f)
 , wheelsRollAngle(0.f), steeringAngle(0.f)
 , isHeadlightOn(false), isBraking(false)
 , isLeftBlinkerActivated(false), isRightBlinkerActivated(false)
 , isBlinkerOn(false), blinkerTimer(0.f)
+, frameDrawId_(0), windowDrawId_(0)
+, bodyMaterial(0), windowMaterial(0), texture(nullptr), windowTexture(nullptr)
+, transforms(nullptr), lights(nullptr)
 {}
 
-void Car::loadModels()
+void Car::loadModels(AssetLoader& loader)
 {
     const char* WINDOW_MODEL_PATHES[] =
     {
@@ -44,13 +68,60 @@ void Car::loadModels()
     };
     for (unsigned int i = 0; i < 6; ++i)
     {
-        windows[i].load(WINDOW_MODEL_PATHES[i]);
+        loader.addModel(windows[i], WINDOW_MODEL_PATHES[i]);
     }
 
-    frame_.load("../models/frame.ply");
-    wheel_.load("../models/wheel.ply");
-    blinker_.load("../models/blinker.ply");
-    light_.load("../models/light.ply");
+    loader.addModel(frame_, "../models/frame.ply");
+    loader.addModel(wheel_, "../models/wheel.ply");
+    loader.addModel(blinker_, "../models/blinker.ply");
+    loader.addModel(light_, "../models/light.ply");
+}
+
+void Car::registerMaterials(MaterialTable& table)
+{
+    const glm::vec3 BLINKER_ON_COLOR (1.0f, 0.7f , 0.3f );
+    const glm::vec3 BLINKER_OFF_COLOR(0.5f, 0.35f, 0.15f);
+
+    Material blinkerMat =
+    {
+        {BLINKER_OFF_COLOR, 0.0f},
+        {BLINKER_OFF_COLOR, 0.0f},
+        {BLINKER_OFF_COLOR, 0.0f},
+        {BLINKER_OFF_COLOR},
+        10.0f
+    };
+    blinkerOffMat_ = table.add(blinkerMat);
+    blinkerMat.emission = glm::vec4(BLINKER_ON_COLOR, 0.0f);
+    blinkerOnMat_ = table.add(blinkerMat);
+
+    const glm::vec3 FRONT_ON_COLOR (1.0f, 1.0f, 1.0f);
+    const glm::vec3 FRONT_OFF_COLOR(0.5f, 0.5f, 0.5f);
+    const glm::vec3 REAR_ON_COLOR  (1.0f, 0.1f, 0.1f);
+    const glm::vec3 REAR_OFF_COLOR (0.5f, 0.1f, 0.1f);
+
+    Material lightFrontMat =
+    {
+        {0.0f, 0.0f, 0.0f, 0.0f},
+        {FRONT_OFF_COLOR, 0.0f},
+        {FRONT_OFF_COLOR, 0.0f},
+        {FRONT_OFF_COLOR},
+        10.0f
+    };
+    lightFrontOffMat_ = table.add(lightFrontMat);
+    lightFrontMat.emission = glm::vec4(FRONT_ON_COLOR, 0.0f);
+    lightFrontOnMat_ = table.add(lightFrontMat);
+
+    Material lightRearMat =
+    {
+        {0.0f, 0.0f, 0.0f, 0.0f},
+        {REAR_OFF_COLOR, 0.0f},
+        {REAR_OFF_COLOR, 0.0f},
+        {REAR_OFF_COLOR},
+        10.0f
+    };
+    lightRearOffMat_ = table.add(lightRearMat);
+    lightRearMat.emission = glm::vec4(REAR_ON_COLOR, 0.0f);
+    lightRearOnMat_ = table.add(lightRearMat);
 }
 
 void Car::update(float deltaTime)
@@ -106,7 +177,16 @@ void Car::update(float deltaTime)
     carModel = glm::rotate(carModel, orientation.y, glm::vec3(0.0f, 1.0f, 0.0f));
 }
 
-void Car::draw(glm::mat4& projView, glm::mat4& view)
+bool Car::isVisible(const Frustum& frustum) const
+{
+    // Sphre du chssis largie du rayon d'une roue: couvre aussi roues, phares et vitres.
+    const MeshBounds& frameBounds = frame_.getBounds();
+    glm::vec3 center = glm::vec3(carModel * glm::vec4(frameBounds.center + glm::vec3(0.0f, 0.25f, 0.0f), 1.0f));
+    return isSphereVisible(frustum, center, frameBounds.radius + wheel_.getBounds().radius);
+}
+
+// Toutes les transformations de la voiture sont crites dans l'anneau avant les dessins de l'image.
+void Car::prepareTransforms(glm::mat4& projView, glm::mat4& view)
 {
 	mat4 model = mat4(1.0f);
 	model = translate(model, position);
@@ -114,94 +194,102 @@ void Car::draw(glm::mat4& projView, glm::mat4& view)
 	model = rotate(model, orientation.x, vec3(1.0f, 0.0f, 0.0f));
 	mat4 mvp = projView * model;
 
-    drawFrame(mvp, view);
-    drawWheels(mvp, view);
-    drawHeadlights(mvp, view);
-}
-    
-void Car::drawFrame(mat4& mvp, mat4& view)
-{
-	mat4 model = mat4(1.0f);
-	model = translate(model, vec3(0.0f, 0.25f, 0.0f));
-	mat4 frameMvp = mvp * model;
-
-    glEnable(GL_STENCIL_TEST);
-    glStencilFunc(GL_ALWAYS, 2, 0xFF);
-    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-	celShadingShader->use();
-	mat4 worldModel = carModel * model;
-	celShadingShader->setMatrices(frameMvp, view, worldModel);
-	frame_.draw();
-    
-    glStencilFunc(GL_NOTEQUAL, 2, 0xFF);
-    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
-	edgeEffectShader->use();
-	glUniformMatrix4fv(edgeEffectShader->mvpULoc, 1, GL_FALSE, value_ptr(frameMvp));
-    glDepthMask(GL_FALSE);
-	frame_.draw();
-	glDepthMask(GL_TRUE);
-	glDisable(GL_STENCIL_TEST);
+	mat4 frameModel = translate(mat4(1.0f), vec3(0.0f, 0.25f, 0.0f));
+	mat4 worldFrameModel = carModel * frameModel;
+	mat4 frameMvp = mvp * frameModel;
+	frameDrawId_ = transforms->push(frameMvp, view, worldFrameModel,
+	                                lights->selectDrawLights(view * worldFrameModel, frame_.getBounds()));
+
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		mat4 wheelModel = getWheelModel(WHEEL_POSITIONS[i]);
+		mat4 worldWheelModel = model * wheelModel;
+		mat4 wheelMvp = mvp * wheelModel;
+		wheelDrawIds_[i] = transforms->push(wheelMvp, view, worldWheelModel,
+		                                    lights->selectDrawLights(view * worldWheelModel, wheel_.getBounds()));
+
+		mat4 lightModel = getHeadlightModel(HEADLIGHT_POSITIONS[i], LIGHT_Z_POS);
+		mat4 worldLightModel = model * lightModel;
+		mat4 lightMvp = mvp * lightModel;
+		lightDrawIds_[i] = transforms->push(lightMvp, view, worldLightModel,
+		                                    lights->selectDrawLights(view * worldLightModel, light_.getBounds()));
+
+		mat4 blinkerModel = getHeadlightModel(HEADLIGHT_POSITIONS[i], BLINKER_Z_POS);
+		mat4 worldBlinkerModel = model * blinkerModel;
+		mat4 blinkerMvp = mvp * blinkerModel;
+		blinkerDrawIds_[i] = transforms->push(blinkerMvp, view, worldBlinkerModel,
+		                                      lights->selectDrawLights(view * worldBlinkerModel, blinker_.getBounds()));
+	}
+
+	// Les six vitres partagent la transformation du chssis.
+	mat4 windowModel = model * frameModel;
+	mat4 windowMvp = projView * windowModel;
+	// Les vitres sont contenues dans la sphre du chssis.
+	windowDrawId_ = transforms->push(windowMvp, view, windowModel,
+	                                 lights->selectDrawLights(view * windowModel, frame_.getBounds()));
 }
 
-void Car::drawWindows(glm::mat4& projView, glm::mat4& view)
+void Car::submit(RenderQueue& queue)
 {
-    const glm::vec3 WINDOW_POSITION[] =
+    // Le chssis, les roues et les vitres ont un contour.
+    DrawPacket packet = {};
+    packet.texture = texture;
+    packet.material = bodyMaterial;
+
+    vec3 frameCenter = vec3(carModel * vec4(0.0f, 0.25f, 0.0f, 1.0f));
+    packet.model = &frame_;
+    packet.drawId = frameDrawId_;
+    queue.submitOutlined(RenderPass::Outlined, packet, STATE_NO_DEPTH_WRITE, frameCenter);
+
+    packet.model = &wheel_;
+    packet.state = STATE_NO_CULL;
+    for (unsigned int i = 0; i < 4; i++)
     {
-        glm::vec3(-0.813, 0.755, 0.0),
-        glm::vec3(1.092, 0.761, 0.0),
-        glm::vec3(-0.3412, 0.757, 0.51),
-        glm::vec3(-0.3412, 0.757, -0.51),
-        glm::vec3(0.643, 0.756, 0.508),
-        glm::vec3(0.643, 0.756, -0.508)
-    };
-
-    glDepthMask(GL_FALSE);
-    glDisable(GL_CULL_FACE);
-    glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        vec3 wheelCenter = vec3(carModel * vec4(WHEEL_POSITIONS[i], 1.0f));
+        packet.drawId = wheelDrawIds_[i];
+        queue.submitOutlined(RenderPass::Outlined, packet, 0, wheelCenter);
+    }
 
-    std::map<float, unsigned int> sorted;
-	vec3 cameraPos = vec3(inverse(view)[3]);
-    for (unsigned int i = 0; i < 6; i++)
+    // Les phares crivent aussi le stencil: le contour du chssis, dessin aprs eux, ne doit pas les recouvrir.
+    packet.shader = RenderShader::CelShading;
+    packet.state = STATE_STENCIL_WRITE;
+    for (unsigned int i = 0; i < 4; i++)
     {
-        mat4 model1 = carModel;
-		model1 = translate(model1, vec3(0.0f, 0.25f, 0.0f));
-		model1 = translate(model1, WINDOW_POSITION[i]);
-		float distance = length(cameraPos - vec3(model1[3]));
-		sorted[distance] = i;
+        const vec3& pos = HEADLIGHT_POSITIONS[i];
+        bool isFrontLight = pos[0] < 0.0f;
+        bool isLeftHeadlight = pos[2] > 0.0f;
+        bool isBlinkerActivated = (isLeftHeadlight  && isLeftBlinkerActivated) ||
+                                  (!isLeftHeadlight && isRightBlinkerActivated);
+        vec3 lightCenter = vec3(carModel * vec4(pos, 1.0f));
+
+        packet.model = &light_;
+        packet.drawId = lightDrawIds_[i];
+        if (isFrontLight)
+            packet.material = isHeadlightOn ? lightFrontOnMat_ : lightFrontOffMat_;
+        else
+            packet.material = isBraking ? lightRearOnMat_ : lightRearOffMat_;
+        queue.submit(RenderPass::Opaque, packet, lightCenter);
+
+        packet.model = &blinker_;
+        packet.drawId = blinkerDrawIds_[i];
+        packet.material = (isBlinkerOn && isBlinkerActivated) ? blinkerOnMat_ : blinkerOffMat_;
+        queue.submit(RenderPass::Opaque, packet, lightCenter);
     }
 
-    for (std::map<float, unsigned int>::reverse_iterator it = sorted.rbegin(); it != sorted.rend(); ++it)
+    // Les vitres sont composes par la transparence pondre, sans tri.
+    packet.texture = windowTexture;
+    packet.material = windowMaterial;
+    packet.drawId = windowDrawId_;
+    packet.state = STATE_NO_DEPTH_WRITE | STATE_NO_CULL | STATE_WEIGHTED_BLEND;
+    for (unsigned int i = 0; i < 6; i++)
     {
-		unsigned int i = it->second;
-        mat4 model = mat4(1.0f);
-        model = translate(model, position);
-        model = rotate(model, orientation.y, vec3(0.0f, 1.0f, 0.0f));
-        model = rotate(model, orientation.x, vec3(1.0f, 0.0f, 0.0f));
-		model = translate(model, vec3(0.0f, 0.25f, 0.0f));
-		mat4 mvp = projView * model;
-
-        glEnable(GL_STENCIL_TEST);
-        glStencilFunc(GL_ALWAYS, 2, 0xFF);
-        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-        celShadingShader->use();
-		celShadingShader->setMatrices(mvp, view, model);
-		windows[i].draw();
-
-        glStencilFunc(GL_NOTEQUAL, 2, 0xFF);
-        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
-		edgeEffectShader->use();
-		glUniformMatrix4fv(edgeEffectShader->mvpULoc, 1, GL_FALSE, value_ptr(mvp));
-		windows[i].draw();
-		glDisable(GL_STENCIL_TEST);
+        vec3 windowCenter = vec3(carModel * vec4(WINDOW_POSITION[i] + vec3(0.0f, 0.25f, 0.0f), 1.0f));
+        packet.model = &windows[i];
+        queue.submitOutlined(RenderPass::Transparent, packet, 0, windowCenter);
     }
-
-	glDisable(GL_BLEND);
-    glEnable(GL_CULL_FACE);
-    glDepthMask(GL_TRUE);
 }
 
-void Car::drawWheel(mat4& mvp, mat4& view, vec3& pos)
+mat4 Car::getWheelModel(const vec3& pos)
 {
 	const float WHEEL_CENTER_OFFSET = 0.10124f;
     bool isFrontWheel = pos[0] < 0.0f;
@@ -223,156 +311,15 @@ void Car::drawWheel(mat4& mvp, mat4& view, vec3& pos)
 	if (isLeftWheel) {
         model = scale(model, vec3(1.0f, 1.0f, -1.0f));
 	}
-
-    mat4 wheelMvp = mvp * model;
-
-	glDisable(GL_CULL_FACE);
-    glEnable(GL_STENCIL_TEST);
-    glStencilFunc(GL_ALWAYS, 2, 0xFF);
-    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-    celShadingShader->use();
-	celShadingShader->setMatrices(wheelMvp, view, model);
-	wheel_.draw();
-
-    glStencilFunc(GL_NOTEQUAL, 2, 0xFF);
-    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
-	edgeEffectShader->use();
-	glUniformMatrix4fv(edgeEffectShader->mvpULoc, 1, GL_FALSE, value_ptr(wheelMvp));
-	wheel_.draw();
-	glDisable(GL_STENCIL_TEST);
-    glEnable(GL_CULL_FACE);
+	return model;
 }
 
-void Car::drawWheels(mat4& mvp, mat4& view)
+mat4 Car::getHeadlightModel(const vec3& pos, float zPos)
 {
-    const glm::vec3 WHEEL_POSITIONS[] =
-    {
-        glm::vec3(-1.29f, 0.245f, -0.57f),
-        glm::vec3(-1.29f, 0.245f,  0.57f),
-        glm::vec3( 1.4f , 0.245f, -0.57f),
-        glm::vec3( 1.4f , 0.245f,  0.57f)
-    };
-
-    for (vec3 position : WHEEL_POSITIONS)
-    {
-		drawWheel(mvp, view, position);
-	}
-}
-
-void Car::drawBlinker(mat4& mvp, mat4& view, vec3& pos)
-{
-    const float BLINKER_Z_POS = -0.06065f;
-    
 	bool isLeftHeadlight = pos[2] > 0.0f;
-    bool isBlinkerActivated = (isLeftHeadlight  && isLeftBlinkerActivated) ||
-                              (!isLeftHeadlight && isRightBlinkerActivated);
-
-    const glm::vec3 ON_COLOR (1.0f, 0.7f , 0.3f );
-    const glm::vec3 OFF_COLOR(0.5f, 0.35f, 0.15f);
-
-    Material blinkerMat =
-    {
-        {0.0f, 0.0f, 0.0f, 0.0f},
-        {OFF_COLOR, 0.0f},
-        {OFF_COLOR, 0.0f},
-        {OFF_COLOR},
-        10.0f
-    };
-    
-	mat4 model = mat4(1.0f);
-	model = translate(model, vec3(0.0f, 0.0f, (isLeftHeadlight ? -1 : 1) * BLINKER_Z_POS));
-	model = translate(model, pos);
-	mat4 blinkerMvp = mvp * model;
-
-	celShadingShader->use();
-	celShadingShader->setMatrices(blinkerMvp, view, model);
-
-    if (isBlinkerOn && isBlinkerActivated)
-        blinkerMat.emission = glm::vec4(ON_COLOR, 0.0f);
-    else
-        blinkerMat.emission = glm::vec4(OFF_COLOR, 0.0f);
-    
-	material->updateData(&blinkerMat, 0, sizeof(Material));
-	blinker_.draw();
-}
-
-void Car::drawLight(mat4& mvp, mat4& view, vec3& pos)
-{
-	const float LIGHT_Z_POS = 0.029f;
-
-    const glm::vec3 FRONT_ON_COLOR (1.0f, 1.0f, 1.0f);
-    const glm::vec3 FRONT_OFF_COLOR(0.5f, 0.5f, 0.5f);
-    const glm::vec3 REAR_ON_COLOR  (1.0f, 0.1f, 0.1f);
-    const glm::vec3 REAR_OFF_COLOR (0.5f, 0.1f, 0.1f);
-
-    Material lightFrontMat =
-    {
-        {0.0f, 0.0f, 0.0f, 0.0f},
-        {FRONT_OFF_COLOR, 0.0f},
-        {FRONT_OFF_COLOR, 0.0f},
-        {FRONT_OFF_COLOR},
-        10.0f
-    };
 
-    Material lightRearMat =
-    {
-        {0.0f, 0.0f, 0.0f, 0.0f},
-        {REAR_OFF_COLOR, 0.0f},
-        {REAR_OFF_COLOR, 0.0f},
-        {REAR_OFF_COLOR},
-        10.0f
-    };
-
-	bool isFrontLight = pos[0] < 0.0f;
-	bool isLeftHeadlight = pos[2] > 0.0f;
-    
 	mat4 model = mat4(1.0f);
-	model = translate(model, vec3(0.0f, 0.0f, (isLeftHeadlight ? -1 : 1) * LIGHT_Z_POS));
+	model = translate(model, vec3(0.0f, 0.0f, (isLeftHeadlight ? -1 : 1) * zPos));
 	model = translate(model, pos);
-	mat4 lightMvp = mvp * model;
-
-	celShadingShader->use();
-	celShadingShader->setMatrices(lightMvp, view, model);
-    
-    if (isFrontLight)
-    {
-        if (isHeadlightOn)
-            lightFrontMat.emission = glm::vec4(FRONT_ON_COLOR, 0.0f);
-        else
-            lightFrontMat.emission = glm::vec4(0.0f);
-		material->updateData(&lightFrontMat, 0, sizeof(Material));
-    }
-    else
-    {
-        if (isBraking)
-            lightRearMat.emission = glm::vec4(REAR_ON_COLOR, 0.0f);
-        else
-            lightRearMat.emission = glm::vec4(0.0f);
-		material->updateData(&lightRearMat, 0, sizeof(Material));
-    }
-
-	light_.draw();
-}
-
-void Car::drawHeadlight(mat4& mvp, mat4& view, vec3& pos)
-{
-    drawLight(mvp, view, pos);
-	drawBlinker(mvp, view, pos);
-}
-
-void Car::drawHeadlights(mat4& mvp, mat4& view)
-{
-    const glm::vec3 HEADLIGHT_POSITIONS[] =
-    {
-        glm::vec3(-2.0019f, 0.64f, -0.45f),
-        glm::vec3(-2.0019f, 0.64f,  0.45f),
-        glm::vec3( 2.0019f, 0.64f, -0.45f),
-        glm::vec3( 2.0019f, 0.64f,  0.45f)
-    };
-
-    for (vec3 position : HEADLIGHT_POSITIONS)
-    {
-        drawHeadlight(mvp, view, position);
-    }
+	return model;
 }
-
@@ -3,34 +3,36 @@
 #include <glbinding/gl/gl.h>
 #include <glm/glm.hpp>
 
+#include "frustum.hpp"
+#include "material.hpp"
 #include "model.hpp"
-#include "uniform_buffer.hpp"
+#include "render_queue.hpp"
 
-class EdgeEffect;
-class CelShading;
+class AssetLoader;
+class LightManager;
+class Texture2D;
+class TransformRing;
 
 class Car
 {   
 public:
     Car();
     
-    void loadModels();
+    void loadModels(AssetLoader& loader);
+
+    void registerMaterials(MaterialTable& table); // Avant MaterialTable::upload.
     
     void update(float deltaTime);
+
+    bool isVisible(const Frustum& frustum) const;
     
-    void draw(glm::mat4& projView, glm::mat4& view); //  besoin de la matrice de vue sparment, pour la partie 3.
-    
-    void drawWindows(glm::mat4& projView, glm::mat4& view); // Dessin des vitres spares.
+    void prepareTransforms(glm::mat4& projView, glm::mat4& view); // Avant TransformRing::endWrites.
+
+    // Dessins de la voiture pour l'image, aprs prepareTransforms.
+    void submit(RenderQueue& queue);
 private:
-	void drawFrame(glm::mat4& mvp, glm::mat4& view);
-    
-    void drawWheel(glm::mat4& mvp, glm::mat4& view, glm::vec3& pos);
-    void drawWheels(glm::mat4& mvp, glm::mat4& view);
-    
-    void drawBlinker(glm::mat4& mvp, glm::mat4& view, glm::vec3& pos);
-    void drawLight(glm::mat4& mvp, glm::mat4& view, glm::vec3& pos);    
-    void drawHeadlight(glm::mat4& mvp, glm::mat4& view, glm::vec3& pos);
-    void drawHeadlights(glm::mat4& mvp, glm::mat4& view);
+    glm::mat4 getWheelModel(const glm::vec3& pos);
+    glm::mat4 getHeadlightModel(const glm::vec3& pos, float zPos);
     
 private:
     Model windows[6]; // Nouveaux modles  ajouter.
@@ -38,6 +40,19 @@ private:
     Model wheel_;
     Model blinker_;
     Model light_;
+
+    MaterialHandle blinkerOnMat_;
+    MaterialHandle blinkerOffMat_;
+    MaterialHandle lightFrontOnMat_;
+    MaterialHandle lightFrontOffMat_;
+    MaterialHandle lightRearOnMat_;
+    MaterialHandle lightRearOffMat_;
+
+    GLuint frameDrawId_;
+    GLuint wheelDrawIds_[4];
+    GLuint lightDrawIds_[4];
+    GLuint blinkerDrawIds_[4];
+    GLuint windowDrawId_;
     
 public:
     glm::vec3 position;
@@ -55,9 +70,12 @@ public:
     bool isBlinkerOn;
     float blinkerTimer;
 
-    EdgeEffect* edgeEffectShader;
-    CelShading* celShadingShader;
-    UniformBuffer* material;
+    MaterialHandle bodyMaterial;
+    MaterialHandle windowMaterial;
+    Texture2D* texture;
+    Texture2D* windowTexture;
+    TransformRing* transforms;
+    LightManager* lights; // Listes de projecteurs par dessin, aprs LightManager::update.
 };
 
 
@@ -0,0 +1,138 @@
+#include "frustum.hpp"
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #include <xmmintrin.h>
+    #define FRUSTUM_USE_SSE
+#endif
+
+Frustum extractFrustum(const glm::mat4& projView)
+{
+    // Rangées de la matrice, glm étant en colonnes.
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++)
+        row[i] = glm::vec4(projView[0][i], projView[1][i], projView[2][i], projView[3][i]);
+
+    Frustum frustum;
+    frustum.planes[0] = row[3] + row[0]; // Gauche
+    frustum.planes[1] = row[3] - row[0]; // Droite
+    frustum.planes[2] = row[3] + row[1]; // Bas
+    frustum.planes[3] = row[3] - row[1]; // Haut
+    frustum.planes[4] = row[3] + row[2]; // Proche
+    frustum.planes[5] = row[3] - row[2]; // Loin
+
+    for (glm::vec4& plane : frustum.planes)
+    {
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f)
+            plane = plane / length;
+    }
+    return frustum;
+}
+
+bool isSphereVisible(const Frustum& frustum, const glm::vec3& center, float radius)
+{
+    for (const glm::vec4& plane : frustum.planes)
+    {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+bool isBoxVisible(const Frustum& frustum, const glm::vec3& center, const glm::vec3& extent)
+{
+    // Rayon projeté de la boîte sur la normale du plan.
+    for (const glm::vec4& plane : frustum.planes)
+    {
+        glm::vec3 normal(plane);
+        float radius = extent.x * std::fabs(normal.x) + extent.y * std::fabs(normal.y) + extent.z * std::fabs(normal.z);
+        if (glm::dot(normal, center) + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+size_t cullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+                   size_t count, unsigned char* visible)
+{
+    size_t nVisible = 0;
+    size_t i = 0;
+
+#ifdef FRUSTUM_USE_SSE
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(x + i);
+        __m128 cy = _mm_loadu_ps(y + i);
+        __m128 cz = _mm_loadu_ps(z + i);
+        __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+        __m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps()); // Tous les bits à 1.
+        for (const glm::vec4& plane : frustum.planes)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+                                         _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for (int k = 0; k < 4; k++)
+        {
+            visible[i + k] = (mask >> k) & 1;
+            nVisible += visible[i + k];
+        }
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        visible[i] = isSphereVisible(frustum, glm::vec3(x[i], y[i], z[i]), radius[i]) ? 1 : 0;
+        nVisible += visible[i];
+    }
+    return nVisible;
+}
+
+size_t cullBoxes(const Frustum& frustum, const float* x, const float* y, const float* z,
+                 const float* extentX, const float* extentY, const float* extentZ,
+                 size_t count, unsigned char* visible)
+{
+    size_t nVisible = 0;
+    size_t i = 0;
+
+#ifdef FRUSTUM_USE_SSE
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(x + i);
+        __m128 cy = _mm_loadu_ps(y + i);
+        __m128 cz = _mm_loadu_ps(z + i);
+        __m128 ex = _mm_loadu_ps(extentX + i);
+        __m128 ey = _mm_loadu_ps(extentY + i);
+        __m128 ez = _mm_loadu_ps(extentZ + i);
+
+        __m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps()); // Tous les bits à 1.
+        for (const glm::vec4& plane : frustum.planes)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+                                         _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(std::fabs(plane.x))), _mm_mul_ps(ey, _mm_set1_ps(std::fabs(plane.y)))),
+                                       _mm_mul_ps(ez, _mm_set1_ps(std::fabs(plane.z))));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for (int k = 0; k < 4; k++)
+        {
+            visible[i + k] = (mask >> k) & 1;
+            nVisible += visible[i + k];
+        }
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        visible[i] = isBoxVisible(frustum, glm::vec3(x[i], y[i], z[i]), glm::vec3(extentX[i], extentY[i], extentZ[i])) ? 1 : 0;
+        nVisible += visible[i];
+    }
+    return nVisible;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+// Volume de vue: six plans (a, b, c, d) normalisés, orientés vers l'intérieur.
+struct Frustum
+{
+    glm::vec4 planes[6];
+};
+
+// Extraction des plans à partir de la matrice projection * vue (Gribb et Hartmann).
+Frustum extractFrustum(const glm::mat4& projView);
+
+bool isSphereVisible(const Frustum& frustum, const glm::vec3& center, float radius);
+bool isBoxVisible(const Frustum& frustum, const glm::vec3& center, const glm::vec3& extent);
+
+// Tests par lots en SSE, quatre volumes à la fois. Les sphères et les boîtes sont en SoA,
+// visible[i] reçoit 0 ou 1. Retourne le nombre de volumes visibles.
+size_t cullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+                   size_t count, unsigned char* visible);
+size_t cullBoxes(const Frustum& frustum, const float* x, const float* y, const float* z,
+                 const float* extentX, const float* extentY, const float* extentZ,
+                 size_t count, unsigned char* visible);
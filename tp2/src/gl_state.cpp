@@ -0,0 +1,218 @@
+#include "gl_state.hpp"
+
+GLStateCache& GLStateCache::get()
+{
+    static GLStateCache cache;
+    return cache;
+}
+
+GLStateCache::GLStateCache()
+: counters_{}, lastFrameCounters_{}
+{
+    invalidate();
+}
+
+void GLStateCache::beginFrame()
+{
+    lastFrameCounters_ = counters_;
+    counters_ = {};
+    invalidate();
+}
+
+void GLStateCache::invalidate()
+{
+    program_ = INVALID_NAME;
+    activeTextureUnit_ = INVALID_NAME;
+    for (GLuint unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+        for (int target = 0; target < N_TEXTURE_TARGETS; target++)
+            textures_[unit][target] = INVALID_NAME;
+    vao_ = INVALID_NAME;
+    for (UniformBinding& binding : uniformBindings_)
+        binding.buffer = INVALID_NAME;
+    for (GLuint i = 0; i < MAX_VERTEX_ATTRIBS; i++)
+        hasVertexAttrib_[i] = hasVertexAttribI_[i] = false;
+
+    for (int& capability : capabilities_)
+        capability = -1;
+    depthMask_ = -1;
+    hasDepthFunc_ = false;
+    hasStencilFunc_ = false;
+    hasStencilOp_ = false;
+    hasBlendFunc_ = false;
+}
+
+bool GLStateCache::skip(bool isCurrent)
+{
+    if (isCurrent)
+        counters_.skipped++;
+    else
+        counters_.issued++;
+    return isCurrent;
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+    if (skip(program_ == program))
+        return;
+    glUseProgram(program);
+    program_ = program;
+}
+
+void GLStateCache::forgetProgram(GLuint program)
+{
+    if (program_ == program)
+        program_ = INVALID_NAME;
+}
+
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    int targetIndex;
+    switch (target)
+    {
+    case GL_TEXTURE_CUBE_MAP: targetIndex = TEXTURE_CUBE_MAP; break;
+    case GL_TEXTURE_BUFFER:   targetIndex = TEXTURE_BUFFER;   break;
+    default:                  targetIndex = TEXTURE_2D;       break;
+    }
+
+    // L'unité est sélectionnée même si la liaison est déjà faite: les glTexParameter qui
+    // suivent un use() (Texture2D::setWrap, ...) visent la texture de cette unité.
+    if (activeTextureUnit_ != unit)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeTextureUnit_ = unit;
+        counters_.issued++;
+    }
+
+    GLuint& current = textures_[unit][targetIndex];
+    if (skip(current == texture))
+        return;
+    glBindTexture(target, texture);
+    current = texture;
+}
+
+void GLStateCache::bindVertexArray(GLuint vao)
+{
+    if (skip(vao_ == vao))
+        return;
+    glBindVertexArray(vao);
+    vao_ = vao;
+}
+
+void GLStateCache::bindUniformBuffer(GLuint index, GLuint buffer)
+{
+    UniformBinding& current = uniformBindings_[index];
+    if (skip(current.buffer == buffer && current.size == 0))
+        return;
+    glBindBufferBase(GL_UNIFORM_BUFFER, index, buffer);
+    current = { buffer, 0, 0 };
+}
+
+void GLStateCache::bindUniformBufferRange(GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    UniformBinding& current = uniformBindings_[index];
+    if (skip(current.buffer == buffer && current.offset == offset && current.size == size))
+        return;
+    glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, offset, size);
+    current = { buffer, offset, size };
+}
+
+void GLStateCache::setVertexAttrib(GLuint index, const glm::vec4& value)
+{
+    if (skip(hasVertexAttrib_[index] && vertexAttribs_[index] == value))
+        return;
+    glVertexAttrib4f(index, value.x, value.y, value.z, value.w);
+    vertexAttribs_[index] = value;
+    hasVertexAttrib_[index] = true;
+    hasVertexAttribI_[index] = false;
+}
+
+void GLStateCache::setVertexAttribI(GLuint index, GLuint value)
+{
+    if (skip(hasVertexAttribI_[index] && vertexAttribsI_[index] == value))
+        return;
+    glVertexAttribI1ui(index, value);
+    vertexAttribsI_[index] = value;
+    hasVertexAttribI_[index] = true;
+    hasVertexAttrib_[index] = false;
+}
+
+void GLStateCache::setEnabled(GLenum capability, bool isEnabled)
+{
+    int index;
+    switch (capability)
+    {
+    case GL_DEPTH_TEST:   index = CAP_DEPTH_TEST;   break;
+    case GL_STENCIL_TEST: index = CAP_STENCIL_TEST; break;
+    case GL_BLEND:        index = CAP_BLEND;        break;
+    case GL_CULL_FACE:    index = CAP_CULL_FACE;    break;
+    default:              index = -1;               break;
+    }
+
+    if (index >= 0 && skip(capabilities_[index] == (int)isEnabled))
+        return;
+    if (isEnabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+    if (index >= 0)
+        capabilities_[index] = isEnabled;
+    else
+        counters_.issued++;
+}
+
+void GLStateCache::setDepthMask(bool isEnabled)
+{
+    if (skip(depthMask_ == (int)isEnabled))
+        return;
+    glDepthMask(isEnabled ? GL_TRUE : GL_FALSE);
+    depthMask_ = isEnabled;
+}
+
+void GLStateCache::setDepthFunc(GLenum func)
+{
+    if (skip(hasDepthFunc_ && depthFunc_ == func))
+        return;
+    glDepthFunc(func);
+    depthFunc_ = func;
+    hasDepthFunc_ = true;
+}
+
+void GLStateCache::setStencilFunc(GLenum func, GLint ref, GLuint mask)
+{
+    if (skip(hasStencilFunc_ && stencilFunc_ == func && stencilRef_ == ref && stencilMask_ == mask))
+        return;
+    glStencilFunc(func, ref, mask);
+    stencilFunc_ = func;
+    stencilRef_ = ref;
+    stencilMask_ = mask;
+    hasStencilFunc_ = true;
+}
+
+void GLStateCache::setStencilOp(GLenum stencilFail, GLenum depthFail, GLenum depthPass)
+{
+    if (skip(hasStencilOp_ && stencilOps_[0] == stencilFail && stencilOps_[1] == depthFail && stencilOps_[2] == depthPass))
+        return;
+    glStencilOp(stencilFail, depthFail, depthPass);
+    stencilOps_[0] = stencilFail;
+    stencilOps_[1] = depthFail;
+    stencilOps_[2] = depthPass;
+    hasStencilOp_ = true;
+}
+
+void GLStateCache::setBlendFunc(GLenum src, GLenum dst)
+{
+    setBlendFuncSeparate(src, dst, src, dst);
+}
+
+void GLStateCache::setBlendFuncSeparate(GLenum srcRgb, GLenum dstRgb, GLenum srcAlpha, GLenum dstAlpha)
+{
+    if (skip(hasBlendFunc_ && blendFactors_[0] == srcRgb && blendFactors_[1] == dstRgb
+             && blendFactors_[2] == srcAlpha && blendFactors_[3] == dstAlpha))
+        return;
+    glBlendFuncSeparate(srcRgb, dstRgb, srcAlpha, dstAlpha);
+    blendFactors_[0] = srcRgb;
+    blendFactors_[1] = dstRgb;
+    blendFactors_[2] = srcAlpha;
+    blendFactors_[3] = dstAlpha;
+    hasBlendFunc_ = true;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+using namespace gl;
+
+struct GLStateCounters
+{
+    unsigned int issued;
+    unsigned int skipped; // Appels évités parce que l'état demandé était déjà courant.
+};
+
+// Copie de l'état OpenGL modifié par le rendu. Les changements passent par ici et ne sont
+// envoyés au pilote que s'ils modifient l'état courant. Tout le code qui touche à ces états
+// doit passer par le cache, sinon invalidate() avant de s'en servir à nouveau.
+class GLStateCache
+{
+public:
+    static const GLuint MAX_TEXTURE_UNITS = 6;
+    static const GLuint MAX_UNIFORM_BINDINGS = 4;
+    static const GLuint MAX_VERTEX_ATTRIBS = 16;
+
+    static GLStateCache& get();
+
+    // Début d'image: l'état est inconnu (ImGui dessine entre deux images) et les compteurs repartent à zéro.
+    void beginFrame();
+    void invalidate();
+    const GLStateCounters& getLastFrameCounters() const { return lastFrameCounters_; }
+
+    void useProgram(GLuint program);
+    void forgetProgram(GLuint program); // Avant glDeleteProgram: le nom peut être réutilisé.
+
+    // Laisse toujours unit active, même quand la liaison est évitée.
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    void bindVertexArray(GLuint vao);
+    void bindUniformBuffer(GLuint index, GLuint buffer); // glBindBufferBase
+    void bindUniformBufferRange(GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+    // Attributs de vertex constants (format compact, identifiant de dessin).
+    void setVertexAttrib(GLuint index, const glm::vec4& value);
+    void setVertexAttribI(GLuint index, GLuint value);
+
+    void setEnabled(GLenum capability, bool isEnabled); // GL_DEPTH_TEST, GL_STENCIL_TEST, GL_BLEND, GL_CULL_FACE
+    void setDepthMask(bool isEnabled);
+    void setDepthFunc(GLenum func);
+    void setStencilFunc(GLenum func, GLint ref, GLuint mask);
+    void setStencilOp(GLenum stencilFail, GLenum depthFail, GLenum depthPass);
+    void setBlendFunc(GLenum src, GLenum dst);
+    void setBlendFuncSeparate(GLenum srcRgb, GLenum dstRgb, GLenum srcAlpha, GLenum dstAlpha);
+
+private:
+    GLStateCache();
+
+    bool skip(bool isCurrent);
+
+    enum Capability { CAP_DEPTH_TEST, CAP_STENCIL_TEST, CAP_BLEND, CAP_CULL_FACE, N_CAPABILITIES };
+    enum TextureTarget { TEXTURE_2D, TEXTURE_CUBE_MAP, TEXTURE_BUFFER, N_TEXTURE_TARGETS };
+
+    struct UniformBinding
+    {
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size; // 0 pour glBindBufferBase.
+    };
+
+    // Après invalidate(), les noms valent INVALID_NAME, les booléens -1 et les has* faux:
+    // le premier appel est toujours envoyé.
+    static const GLuint INVALID_NAME = ~0u;
+
+    GLuint program_;
+    GLuint activeTextureUnit_;
+    GLuint textures_[MAX_TEXTURE_UNITS][N_TEXTURE_TARGETS];
+    GLuint vao_;
+    UniformBinding uniformBindings_[MAX_UNIFORM_BINDINGS];
+    glm::vec4 vertexAttribs_[MAX_VERTEX_ATTRIBS];
+    GLuint vertexAttribsI_[MAX_VERTEX_ATTRIBS];
+    bool hasVertexAttrib_[MAX_VERTEX_ATTRIBS];
+    bool hasVertexAttribI_[MAX_VERTEX_ATTRIBS];
+
+    int capabilities_[N_CAPABILITIES];
+    int depthMask_;
+    bool hasDepthFunc_;
+    GLenum depthFunc_;
+    bool hasStencilFunc_;
+    GLenum stencilFunc_;
+    GLint stencilRef_;
+    GLuint stencilMask_;
+    bool hasStencilOp_;
+    GLenum stencilOps_[3];
+    bool hasBlendFunc_;
+    GLenum blendFactors_[4]; // srcRgb, dstRgb, srcAlpha, dstAlpha
+
+    GLStateCounters counters_;
+    GLStateCounters lastFrameCounters_;
+};
@@ -50,6 +50,7 @@ SOFTWARE.
 
 #include <array>
 #include <cctype>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <limits>
@@ -162,6 +163,27 @@ public:
    */
   virtual void readNextBigEndian(std::istream& stream) = 0;
 
+  /**
+   * @brief (binary reading) Size in bytes of one value of this property in a binary file, or 0 if the size varies from
+   * element to element (lists).
+   *
+   * @return
+   */
+  virtual size_t fixedByteSize() { return 0; }
+
+  /**
+   * @brief (binary reading) Append values for many elements at once, from a block of interleaved element records
+   * already read in memory. Only valid when fixedByteSize() is nonzero.
+   *
+   * @param block Pointer to the first value of this property in the block.
+   * @param count Number of elements in the block.
+   * @param stride Size in bytes of one element record.
+   * @param bigEndian Whether the values must be byte-swapped.
+   */
+  virtual void readBlock(const char* block, size_t count, size_t stride, bool bigEndian) {
+    throw std::runtime_error("PLY parser: property " + name + " does not support block reading");
+  }
+
   /**
    * @brief (reading) Write a header entry for this property.
    *
@@ -242,6 +264,38 @@ T swapEndian(T val) {
 template <> int8_t swapEndian<int8_t>(int8_t val) { return val; }
 template <> uint8_t swapEndian<uint8_t>(uint8_t val) { return val; }
 
+/**
+ * Swap endianness of a contiguous array in place. Written as plain shifts on unsigned words so that the compiler can
+ * vectorize the loop (pshufb / rev on most targets).
+ *
+ * @param values Array to swap.
+ * @param count Number of values.
+ */
+template <typename T>
+void swapEndianBlock(T* values, size_t count) {
+  if constexpr (sizeof(T) == 2) {
+    uint16_t* words = reinterpret_cast<uint16_t*>(values);
+    for (size_t i = 0; i < count; i++) {
+      uint16_t v = words[i];
+      words[i] = (uint16_t)((v >> 8) | (v << 8));
+    }
+  } else if constexpr (sizeof(T) == 4) {
+    uint32_t* words = reinterpret_cast<uint32_t*>(values);
+    for (size_t i = 0; i < count; i++) {
+      uint32_t v = words[i];
+      words[i] = (v >> 24) | ((v >> 8) & 0x0000FF00u) | ((v << 8) & 0x00FF0000u) | (v << 24);
+    }
+  } else if constexpr (sizeof(T) == 8) {
+    uint64_t* words = reinterpret_cast<uint64_t*>(values);
+    for (size_t i = 0; i < count; i++) {
+      uint64_t v = words[i];
+      v = ((v & 0x00000000FFFFFFFFull) << 32) | ((v & 0xFFFFFFFF00000000ull) >> 32);
+      v = ((v & 0x0000FFFF0000FFFFull) << 16) | ((v & 0xFFFF0000FFFF0000ull) >> 16);
+      words[i] = ((v & 0x00FF00FF00FF00FFull) << 8) | ((v & 0xFF00FF00FF00FF00ull) >> 8);
+    }
+  }
+}
+
 
 // Unpack flattened list from the convention used in TypedListProperty
 template <typename T>
@@ -345,6 +399,37 @@ public:
     data.back() = swapEndian(data.back());
   }
 
+  /**
+   * @brief (binary reading) Size in bytes of one value of this property.
+   *
+   * @return
+   */
+  virtual size_t fixedByteSize() override { return sizeof(T); }
+
+  /**
+   * @brief (binary reading) Append values for many elements at once, with a strided copy out of the element block.
+   *
+   * @param block Pointer to the first value of this property in the block.
+   * @param count Number of elements in the block.
+   * @param stride Size in bytes of one element record.
+   * @param bigEndian Whether the values must be byte-swapped.
+   */
+  virtual void readBlock(const char* block, size_t count, size_t stride, bool bigEndian) override {
+    size_t currSize = data.size();
+    data.resize(currSize + count);
+    T* dst = data.data() + currSize;
+    if (stride == sizeof(T)) {
+      std::memcpy(dst, block, count * sizeof(T));
+    } else {
+      for (size_t i = 0; i < count; i++) {
+        std::memcpy(dst + i, block + i * stride, sizeof(T));
+      }
+    }
+    if (bigEndian) {
+      swapEndianBlock(dst, count);
+    }
+  }
+
   /**
    * @brief (reading) Write a header entry for this property.
    *
@@ -1005,6 +1090,40 @@ public:
   }
 
 
+  /**
+   * @brief Same as getListPropertyAnySign(), but returns the lists as one contiguous buffer instead of one vector per
+   * element. The data is copied (and converted if needed) straight from the flattened storage of the property, so this
+   * costs a single allocation regardless of the number of elements.
+   *
+   * @tparam T The type of data requested
+   * @param propertyName The name of the property to get.
+   * @param listStarts If not null, receives the index in to the returned buffer where each list begins, plus a final
+   * entry holding the total length (size N_elem + 1).
+   *
+   * @return The flattened data.
+   */
+  template <class T>
+  std::vector<T> getListPropertyAnySignFlat(const std::string& propertyName, std::vector<size_t>* listStarts = nullptr) {
+
+    std::unique_ptr<Property>& prop = getPropertyPtr(propertyName);
+
+    try {
+      return getDataFromListPropertyFlatRecursive<T, T>(prop.get(), listStarts);
+    } catch (const std::runtime_error& orig_e) {
+
+      try {
+        typedef typename CanonicalName<T>::type Tcan;
+        typedef typename std::conditional<std::is_signed<Tcan>::value, typename std::make_unsigned<Tcan>::type,
+                                          typename std::make_signed<Tcan>::type>::type OppsignType;
+
+        return getDataFromListPropertyFlatRecursive<T, OppsignType>(prop.get(), listStarts);
+
+      } catch (const std::runtime_error&) {
+        throw orig_e;
+      }
+    }
+  }
+
   /**
    * @brief Get a vector of lists of data from a property for this element. Automatically promotes to larger types.
    * Unlike getListProperty(), this method will additionally convert between types of different sign (eg, requesting and
@@ -1228,6 +1347,39 @@ public:
                                prop->propertyTypeName());
     }
   }
+
+  /**
+   * @brief Flat counterpart of getDataFromListPropertyRecursive(), see getListPropertyAnySignFlat(). Throws if type
+   * conversion fails.
+   *
+   * @tparam D The desired output type
+   * @tparam T The current attempt for the actual type of the property
+   * @param prop The property to get (does not delete nor share pointer)
+   * @param listStarts If not null, receives the start of each list in the returned buffer.
+   *
+   * @return The flattened data, with the requested type
+   */
+  template <class D, class T>
+  std::vector<D> getDataFromListPropertyFlatRecursive(Property* prop, std::vector<size_t>* listStarts) {
+    typedef typename CanonicalName<T>::type Tcan;
+
+    TypedListProperty<Tcan>* castedProp = dynamic_cast<TypedListProperty<Tcan>*>(prop);
+    if (castedProp) {
+      if (listStarts) {
+        *listStarts = castedProp->flattenedIndexStart;
+      }
+      return std::vector<D>(castedProp->flattenedData.begin(), castedProp->flattenedData.end());
+    }
+
+    TypeChain<Tcan> chainType;
+    if (chainType.hasChildType) {
+      return getDataFromListPropertyFlatRecursive<D, typename TypeChain<Tcan>::type>(prop, listStarts);
+    } else {
+      throw std::runtime_error("PLY parser: list property " + prop->name +
+                               " cannot be coerced to requested type list " + typeName<D>() + ". Has type list " +
+                               prop->propertyTypeName());
+    }
+  }
 };
 
 
@@ -1509,6 +1661,53 @@ public:
     throw std::runtime_error("PLY parser: could not find face vertex indices attribute under any common name.");
   }
 
+  /**
+   * @brief Same as getFaceIndices(), but returns every face index in one contiguous buffer.
+   *
+   * @param faceStarts If not null, receives the index in to the returned buffer where each face begins, plus a final
+   * entry holding the total length.
+   *
+   * @return The flattened indices into the vertex elements.
+   */
+  template <typename T = size_t>
+  std::vector<T> getFaceIndicesFlat(std::vector<size_t>* faceStarts = nullptr) {
+
+    for (const std::string& f : std::vector<std::string>{"face"}) {
+      for (const std::string& p : std::vector<std::string>{"vertex_indices", "vertex_index"}) {
+        try {
+          return getElement(f).getListPropertyAnySignFlat<T>(p, faceStarts);
+        } catch (const std::runtime_error&) {
+          // that's fine
+        }
+      }
+    }
+    throw std::runtime_error("PLY parser: could not find face vertex indices attribute under any common name.");
+  }
+
+  /**
+   * @brief Fast path of getFaceIndicesFlat() for triangle meshes: three consecutive indices per face, ready to be used
+   * as an index buffer. Throws if any face is not a triangle.
+   *
+   * @return The flattened triangle indices.
+   */
+  template <typename T = size_t>
+  std::vector<T> getTriangleIndicesFlat() {
+
+    std::vector<size_t> faceStarts;
+    std::vector<T> indices = getFaceIndicesFlat<T>(&faceStarts);
+
+    size_t nFaces = faceStarts.size() - 1;
+    if (indices.size() != 3 * nFaces) {
+      throw std::runtime_error("PLY parser: mesh is not made only of triangles.");
+    }
+    for (size_t iFace = 0; iFace < nFaces; iFace++) {
+      if (faceStarts[iFace + 1] - faceStarts[iFace] != 3) {
+        throw std::runtime_error("PLY parser: face " + std::to_string(iFace) + " is not a triangle.");
+      }
+    }
+    return indices;
+  }
+
 
   /**
    * @brief Common-case helper set mesh vertex positons. Creates vertex element, if necessary.
@@ -1868,6 +2067,44 @@ private:
     }
   }
 
+  /**
+   * @brief Fast path for binary elements whose properties are all fixed-size scalars (no lists). The whole element
+   * block is read with a single read() and then scattered column by column in to the typed properties.
+   *
+   * @param inStream
+   * @param elem Element to read, its properties must already be created.
+   * @param bigEndian Whether the file is big endian.
+   *
+   * @return false if the element has a list property, in which case nothing was read.
+   */
+  bool readFixedStrideElement(std::istream& inStream, Element& elem, bool bigEndian) {
+
+    size_t stride = 0;
+    for (std::unique_ptr<Property>& prop : elem.properties) {
+      size_t propSize = prop->fixedByteSize();
+      if (propSize == 0) {
+        return false;
+      }
+      stride += propSize;
+    }
+    if (stride == 0 || elem.count == 0) {
+      return stride != 0;
+    }
+
+    std::vector<char> block(elem.count * stride);
+    inStream.read(block.data(), block.size());
+    if (!inStream) {
+      throw std::runtime_error("PLY parser: unexpected end of file while reading element " + elem.name);
+    }
+
+    size_t offset = 0;
+    for (std::unique_ptr<Property>& prop : elem.properties) {
+      prop->readBlock(block.data() + offset, elem.count, stride, bigEndian);
+      offset += prop->fixedByteSize();
+    }
+    return true;
+  }
+
   /**
    * @brief Read the actual data for a file, in binary.
    *
@@ -1893,6 +2130,9 @@ private:
       for (size_t iP = 0; iP < elem.properties.size(); iP++) {
         elem.properties[iP]->reserve(elem.count);
       }
+      if (readFixedStrideElement(inStream, elem, false)) {
+        continue;
+      }
       for (size_t iEntry = 0; iEntry < elem.count; iEntry++) {
         for (size_t iP = 0; iP < elem.properties.size(); iP++) {
           elem.properties[iP]->readNext(inStream);
@@ -1926,6 +2166,9 @@ private:
       for (size_t iP = 0; iP < elem.properties.size(); iP++) {
         elem.properties[iP]->reserve(elem.count);
       }
+      if (readFixedStrideElement(inStream, elem, true)) {
+        continue;
+      }
       for (size_t iEntry = 0; iEntry < elem.count; iEntry++) {
         for (size_t iP = 0; iP < elem.properties.size(); iP++) {
           elem.properties[iP]->readNextBigEndian(inStream);
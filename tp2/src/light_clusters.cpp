@@ -0,0 +1,228 @@
+#include "light_clusters.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "gl_state.hpp"
+#include "shaders.hpp"
+
+static GLuint createBufferTexture(GLuint unit, GLenum format, GLuint buffer)
+{
+    GLuint id;
+    glGenTextures(1, &id);
+    GLStateCache::get().bindTexture(unit, GL_TEXTURE_BUFFER, id);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    return id;
+}
+
+// La taille change d'une image à l'autre: le buffer est réalloué, ce qui évite aussi
+// d'attendre le GPU qui lit encore l'image précédente.
+static void uploadBuffer(GLuint buffer, const void* data, GLsizeiptr byteSize)
+{
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max<GLsizeiptr>(byteSize, 4), byteSize > 0 ? data : nullptr, GL_STREAM_DRAW);
+}
+
+// Sphère englobant un cône de demi-angle angle et de longueur range.
+static void computeConeSphere(const SpotLight& light, glm::vec3& center, float& radius)
+{
+    glm::vec3 position = glm::vec3(light.position);
+    glm::vec3 direction = glm::normalize(light.direction);
+    float angle = glm::radians(light.openingAngle);
+
+    if (angle > glm::radians(45.0f))
+    {
+        center = position + direction * (light.range * cos(angle));
+        radius = light.range * sin(angle);
+    }
+    else
+    {
+        radius = light.range / (2.0f * cos(angle));
+        center = position + direction * radius;
+    }
+}
+
+static bool intersects(const glm::vec3& center, float radius, const glm::vec3& min, const glm::vec3& max)
+{
+    glm::vec3 closest = glm::clamp(center, min, max);
+    glm::vec3 d = center - closest;
+    return glm::dot(d, d) <= radius * radius;
+}
+
+LightClusters::LightClusters()
+: gridBuffer_(0), gridTexture_(0), indexBuffer_(0), indexTexture_(0)
+, boundsProjection_(0.0f), near_(0.0f), far_(0.0f), maxLightsPerCluster_(0)
+{
+
+}
+
+LightClusters::~LightClusters()
+{
+    release();
+}
+
+void LightClusters::create()
+{
+    glGenBuffers(1, &gridBuffer_);
+    uploadBuffer(gridBuffer_, nullptr, N_CLUSTERS * 2 * sizeof(uint32_t));
+    gridTexture_ = createBufferTexture(LIGHT_GRID_TEXTURE_UNIT, GL_RG32UI, gridBuffer_);
+
+    glGenBuffers(1, &indexBuffer_);
+    uploadBuffer(indexBuffer_, nullptr, 0);
+    indexTexture_ = createBufferTexture(LIGHT_INDEX_TEXTURE_UNIT, GL_R16UI, indexBuffer_);
+
+    grid_.resize(N_CLUSTERS * 2);
+}
+
+void LightClusters::release()
+{
+    glDeleteTextures(1, &gridTexture_);
+    glDeleteTextures(1, &indexTexture_);
+    glDeleteBuffers(1, &gridBuffer_);
+    glDeleteBuffers(1, &indexBuffer_);
+    gridTexture_ = indexTexture_ = gridBuffer_ = indexBuffer_ = 0;
+}
+
+void LightClusters::computeClusterBounds(const glm::mat4& proj, float near, float far)
+{
+    boundsProjection_ = proj;
+    near_ = near;
+    far_ = far;
+    bounds_.resize(N_CLUSTERS);
+
+    // Un point NDC (x, y) à la profondeur d se trouve en (x * d / P00, y * d / P11, -d).
+    glm::vec2 ndcToView(1.0f / proj[0][0], 1.0f / proj[1][1]);
+
+    for (int slice = 0; slice < SLICES; slice++)
+    {
+        float depth0 = near * pow(far / near, (float)slice / SLICES);
+        float depth1 = near * pow(far / near, (float)(slice + 1) / SLICES);
+
+        for (int y = 0; y < TILES_Y; y++)
+        {
+            for (int x = 0; x < TILES_X; x++)
+            {
+                glm::vec2 ndc0(-1.0f + 2.0f * x / TILES_X, -1.0f + 2.0f * y / TILES_Y);
+                glm::vec2 ndc1(-1.0f + 2.0f * (x + 1) / TILES_X, -1.0f + 2.0f * (y + 1) / TILES_Y);
+
+                Bounds& bounds = bounds_[(slice * TILES_Y + y) * TILES_X + x];
+                bounds.min = glm::vec3(INFINITY);
+                bounds.max = glm::vec3(-INFINITY);
+                for (float depth : { depth0, depth1 })
+                {
+                    for (const glm::vec2& ndc : { ndc0, ndc1 })
+                    {
+                        glm::vec3 corner(ndc * ndcToView * depth, -depth);
+                        bounds.min = glm::min(bounds.min, corner);
+                        bounds.max = glm::max(bounds.max, corner);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void LightClusters::update(const SpotLight* lights, unsigned int nLights, const glm::mat4& proj, float near, float far)
+{
+    if (bounds_.empty() || proj != boundsProjection_ || near != near_ || far != far_)
+        computeClusterBounds(proj, near, far);
+
+    float sliceScale = SLICES / log(far / near);
+    float sliceBias = -SLICES * log(near) / log(far / near);
+
+    pairs_.clear();
+    for (unsigned int i = 0; i < nLights; i++)
+    {
+        const SpotLight& light = lights[i];
+        if (light.range <= 0.0f)
+            continue;
+
+        glm::vec3 center;
+        float radius;
+        computeConeSphere(light, center, radius);
+
+        float minDepth = -center.z - radius;
+        float maxDepth = -center.z + radius;
+        if (maxDepth < near || minDepth > far)
+            continue;
+
+        int slice0 = glm::clamp((int)floor(log(std::max(minDepth, near)) * sliceScale + sliceBias), 0, SLICES - 1);
+        int slice1 = glm::clamp((int)floor(log(std::min(maxDepth, far)) * sliceScale + sliceBias), 0, SLICES - 1);
+
+        // Rectangle d'écran de la boîte de la sphère, si elle est entièrement devant le plan proche.
+        int x0 = 0, x1 = TILES_X - 1, y0 = 0, y1 = TILES_Y - 1;
+        if (minDepth > near)
+        {
+            glm::vec2 ndcMin(INFINITY), ndcMax(-INFINITY);
+            for (float depth : { minDepth, maxDepth })
+            {
+                for (float s : { -1.0f, 1.0f })
+                {
+                    glm::vec2 ndc(proj[0][0] * (center.x + s * radius) / depth,
+                                  proj[1][1] * (center.y + s * radius) / depth);
+                    ndcMin = glm::min(ndcMin, ndc);
+                    ndcMax = glm::max(ndcMax, ndc);
+                }
+            }
+            if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f)
+                continue;
+            x0 = glm::clamp((int)floor((ndcMin.x * 0.5f + 0.5f) * TILES_X), 0, TILES_X - 1);
+            x1 = glm::clamp((int)floor((ndcMax.x * 0.5f + 0.5f) * TILES_X), 0, TILES_X - 1);
+            y0 = glm::clamp((int)floor((ndcMin.y * 0.5f + 0.5f) * TILES_Y), 0, TILES_Y - 1);
+            y1 = glm::clamp((int)floor((ndcMax.y * 0.5f + 0.5f) * TILES_Y), 0, TILES_Y - 1);
+        }
+
+        for (int slice = slice0; slice <= slice1; slice++)
+        {
+            for (int y = y0; y <= y1; y++)
+            {
+                for (int x = x0; x <= x1; x++)
+                {
+                    uint32_t cluster = (slice * TILES_Y + y) * TILES_X + x;
+                    const Bounds& bounds = bounds_[cluster];
+                    if (intersects(center, radius, bounds.min, bounds.max))
+                        pairs_.push_back(cluster << 16 | i);
+                }
+            }
+        }
+    }
+
+    // Tri par dénombrement sur la grappe: les indices d'une grappe sont contigus et
+    // gardent l'ordre des projecteurs.
+    std::fill(grid_.begin(), grid_.end(), 0);
+    for (uint32_t pair : pairs_)
+        grid_[(pair >> 16) * 2 + 1]++;
+
+    uint32_t offset = 0;
+    maxLightsPerCluster_ = 0;
+    for (int cluster = 0; cluster < N_CLUSTERS; cluster++)
+    {
+        uint32_t count = grid_[cluster * 2 + 1];
+        grid_[cluster * 2] = offset;
+        grid_[cluster * 2 + 1] = 0;
+        offset += count;
+        maxLightsPerCluster_ = std::max(maxLightsPerCluster_, (unsigned int)count);
+    }
+
+    indices_.resize(pairs_.size());
+    for (uint32_t pair : pairs_)
+    {
+        uint32_t* cluster = &grid_[(pair >> 16) * 2];
+        indices_[cluster[0] + cluster[1]++] = (uint16_t)(pair & 0xFFFF);
+    }
+
+    uploadBuffer(gridBuffer_, grid_.data(), grid_.size() * sizeof(uint32_t));
+    uploadBuffer(indexBuffer_, indices_.data(), indices_.size() * sizeof(uint16_t));
+}
+
+void LightClusters::use(CelShading& shader, GLsizei width, GLsizei height)
+{
+    GLStateCache& state = GLStateCache::get();
+    state.bindTexture(LIGHT_GRID_TEXTURE_UNIT, GL_TEXTURE_BUFFER, gridTexture_);
+    state.bindTexture(LIGHT_INDEX_TEXTURE_UNIT, GL_TEXTURE_BUFFER, indexTexture_);
+
+    glm::vec2 tileScale((float)TILES_X / width, (float)TILES_Y / height);
+    glm::vec2 sliceParameters(SLICES / log(far_ / near_), -SLICES * log(near_) / log(far_ / near_));
+    shader.use();
+    shader.setClusterParameters(tileScale, sliceParameters);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "lights.hpp"
+
+using namespace gl;
+
+class CelShading;
+
+// Unités des deux buffers de la grille, après celles des textures et du TransformRing.
+const GLuint LIGHT_GRID_TEXTURE_UNIT = 4;
+const GLuint LIGHT_INDEX_TEXTURE_UNIT = 5;
+
+// Éclairage en grappes: le frustum de vue est découpé en tuiles d'écran et en tranches de
+// profondeur exponentielles. Chaque image, le volume englobant de chaque projecteur est
+// réparti sur le CPU dans les grappes qu'il touche; le fragment shader ne parcourt que la
+// liste de sa grappe, son coût ne dépend plus du nombre total de projecteurs.
+class LightClusters
+{
+public:
+    // Doivent correspondre aux CLUSTER_* de phong.fs.glsl.
+    static const int TILES_X = 16;
+    static const int TILES_Y = 9;
+    static const int SLICES = 24;
+    static const int N_CLUSTERS = TILES_X * TILES_Y * SLICES;
+
+    LightClusters();
+    ~LightClusters();
+
+    void create();
+    void release();
+
+    // Répartit les projecteurs, déjà dans l'espace de vue, et envoie la grille et la liste d'indices.
+    void update(const SpotLight* lights, unsigned int nLights, const glm::mat4& proj, float near, float far);
+    // Attache les buffers et donne au shader de quoi retrouver sa grappe.
+    void use(CelShading& shader, GLsizei width, GLsizei height);
+
+    unsigned int getIndexCount() const { return (unsigned int)indices_.size(); }
+    unsigned int getMaxLightsPerCluster() const { return maxLightsPerCluster_; }
+
+private:
+    struct Bounds
+    {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    // Boîtes des grappes dans l'espace de vue, qui ne changent qu'avec la projection.
+    void computeClusterBounds(const glm::mat4& proj, float near, float far);
+
+    GLuint gridBuffer_;
+    GLuint gridTexture_;  // RG32UI: premier indice et nombre de projecteurs par grappe.
+    GLuint indexBuffer_;
+    GLuint indexTexture_; // R16UI: indices dans LightingBlock.spotLights.
+
+    std::vector<Bounds> bounds_;
+    glm::mat4 boundsProjection_;
+    float near_;
+    float far_;
+
+    std::vector<uint32_t> pairs_; // Grappe dans les 16 bits forts, projecteur dans les 16 bits faibles.
+    std::vector<uint32_t> grid_;
+    std::vector<uint16_t> indices_;
+    unsigned int maxLightsPerCluster_;
+};
@@ -0,0 +1,130 @@
+#include "light_manager.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Cône de portée range contre sphère, dans le même espace: hors de l'angle d'ouverture,
+// au-delà de la portée ou derrière le sommet.
+static bool isConeTouchingSphere(const SpotLight& light, const glm::vec3& center, float radius)
+{
+    glm::vec3 v = center - glm::vec3(light.position);
+    float lengthSquared = glm::dot(v, v);
+    float axial = glm::dot(v, light.direction);
+    float angle = glm::radians(light.openingAngle);
+
+    float closestDistance = cos(angle) * sqrt(std::max(lengthSquared - axial * axial, 0.0f)) - axial * sin(angle);
+    return closestDistance <= radius && axial <= light.range + radius && axial >= -radius;
+}
+
+static bool isContributing(const SpotLight& light)
+{
+    // Le terme ambiant est additionné à part dans spotAmbient.
+    return light.range > 0.0f && (glm::vec3(light.diffuse) != glm::vec3(0.0f) || glm::vec3(light.specular) != glm::vec3(0.0f));
+}
+
+LightManager::LightManager()
+: nSpotLights_(0), world_{}, current_{}, uploaded_{}
+, nActiveSpotLights_(0), nUploadedSpotLights_(0), isUploaded_(false), uploadedBytes_(0)
+, nDrawLightTests_(0), nDrawLightsKept_(0), nDrawLightOverflows_(0)
+{
+
+}
+
+void LightManager::create(GLuint bindingIndex, unsigned int nSpotLights)
+{
+    nSpotLights_ = nSpotLights;
+    buffer_.allocate(nullptr, sizeof(LightingData));
+    buffer_.setBindingIndex(bindingIndex);
+}
+
+void LightManager::update(const glm::mat4& view)
+{
+    glm::mat3 viewRotation = glm::mat3(view);
+
+    current_.dirLight = world_.dirLight;
+    current_.dirLight.direction = glm::vec4(glm::normalize(viewRotation * glm::vec3(world_.dirLight.direction)), 0.0f);
+
+    current_.spotAmbient = glm::vec4(0.0f);
+    nActiveSpotLights_ = 0;
+    nDrawLightTests_ = nDrawLightsKept_ = nDrawLightOverflows_ = 0;
+    for (unsigned int i = 0; i < nSpotLights_; i++)
+    {
+        const SpotLight& source = world_.spotLights[i];
+        current_.spotAmbient += source.ambient;
+        if (!isContributing(source))
+            continue;
+
+        SpotLight& light = current_.spotLights[nActiveSpotLights_++];
+        light = source;
+        light.position = view * glm::vec4(glm::vec3(source.position), 1.0f);
+        light.direction = glm::normalize(viewRotation * source.direction);
+    }
+
+    // Plage à envoyer: l'en-tête, puis un emplacement par projecteur actif. Les emplacements
+    // au-delà de nActiveSpotLights_ ne sont jamais lus, leur contenu périmé est sans effet.
+    const size_t HEADER_SIZE = offsetof(LightingData, spotLights);
+    const char* current = (const char*)&current_;
+    const char* uploaded = (const char*)&uploaded_;
+
+    size_t begin = SIZE_MAX;
+    size_t end = 0;
+    auto markIfChanged = [&](size_t offset, size_t size)
+    {
+        if (isUploaded_ && memcmp(current + offset, uploaded + offset, size) == 0)
+            return;
+        begin = std::min(begin, offset);
+        end = std::max(end, offset + size);
+    };
+
+    markIfChanged(0, HEADER_SIZE);
+    for (unsigned int i = 0; i < nActiveSpotLights_; i++)
+    {
+        size_t offset = HEADER_SIZE + i * sizeof(SpotLight);
+        // Un emplacement jamais envoyé n'a pas de copie fiable à comparer.
+        if (i >= nUploadedSpotLights_)
+        {
+            begin = std::min(begin, offset);
+            end = std::max(end, offset + sizeof(SpotLight));
+        }
+        else
+            markIfChanged(offset, sizeof(SpotLight));
+    }
+
+    uploadedBytes_ = 0;
+    if (begin < end)
+    {
+        buffer_.updateData(current + begin, begin, end - begin);
+        memcpy((char*)&uploaded_ + begin, current + begin, end - begin);
+        uploadedBytes_ = (unsigned int)(end - begin);
+    }
+    nUploadedSpotLights_ = std::max(nUploadedSpotLights_, nActiveSpotLights_);
+    isUploaded_ = true;
+}
+
+DrawLights LightManager::selectDrawLights(const glm::mat4& modelView, const MeshBounds& bounds)
+{
+    glm::vec3 center = glm::vec3(modelView * glm::vec4(bounds.center, 1.0f));
+    float scale = std::max(glm::length(glm::vec3(modelView[0])),
+                           std::max(glm::length(glm::vec3(modelView[1])), glm::length(glm::vec3(modelView[2]))));
+    float radius = bounds.radius * scale;
+
+    DrawLights lights = {};
+    for (unsigned int i = 0; i < nActiveSpotLights_; i++)
+    {
+        nDrawLightTests_++;
+        if (!isConeTouchingSphere(current_.spotLights[i], center, radius))
+            continue;
+
+        nDrawLightsKept_++;
+        if (lights.count == MAX_DRAW_LIGHTS)
+        {
+            nDrawLightOverflows_++;
+            lights.count = -1;
+            break;
+        }
+        lights.indices[lights.count++] = i;
+    }
+    return lights;
+}
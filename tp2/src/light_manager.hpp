@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "lights.hpp"
+#include "mesh.hpp"
+#include "uniform_buffer.hpp"
+
+using namespace gl;
+
+// Lumières de la scène et contenu du LightingBlock. L'appelant modifie librement les lumières
+// dans l'espace du monde; update() ne garde que les projecteurs qui éclairent, les passe dans
+// l'espace de vue et n'envoie que la plage d'octets qui diffère de l'envoi précédent.
+class LightManager
+{
+public:
+    LightManager();
+
+    void create(GLuint bindingIndex, unsigned int nSpotLights);
+
+    DirectionalLight& getDirectionalLight() { return world_.dirLight; }
+    SpotLight& getSpotLight(unsigned int index) { return world_.spotLights[index]; }
+
+    void update(const glm::mat4& view);
+
+    // Projecteurs actifs dont le cône touche la sphère englobante du dessin, après update().
+    DrawLights selectDrawLights(const glm::mat4& modelView, const MeshBounds& bounds);
+
+    // Projecteurs compactés, dans l'espace de vue, dans l'ordre du LightingBlock.
+    const SpotLight* getActiveSpotLights() const { return current_.spotLights; }
+    unsigned int getActiveSpotLightCount() const { return nActiveSpotLights_; }
+    unsigned int getSpotLightCount() const { return nSpotLights_; }
+    unsigned int getUploadedBytes() const { return uploadedBytes_; }
+
+    // Paires projecteur-dessin testées et gardées, listes trop longues, depuis le dernier update().
+    unsigned int getDrawLightTests() const { return nDrawLightTests_; }
+    unsigned int getDrawLightsKept() const { return nDrawLightsKept_; }
+    unsigned int getDrawLightOverflows() const { return nDrawLightOverflows_; }
+
+private:
+    UniformBuffer buffer_;
+    unsigned int nSpotLights_;
+
+    LightingData world_;
+    LightingData current_;  // Construit par update().
+    LightingData uploaded_; // Copie de ce qui est dans l'UBO.
+    unsigned int nActiveSpotLights_;
+    unsigned int nUploadedSpotLights_; // Emplacements envoyés au moins une fois.
+    bool isUploaded_;
+
+    unsigned int uploadedBytes_; // Dernière image.
+    unsigned int nDrawLightTests_;
+    unsigned int nDrawLightsKept_;
+    unsigned int nDrawLightOverflows_;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+using namespace gl;
+
+// Doit correspondre à MAX_SPOT_LIGHTS de phong.fs.glsl. Le bloc reste sous les 16 Ko
+// garantis pour un UBO.
+const unsigned int MAX_SPOT_LIGHTS = 128;
+
+// Disposition std140 du bloc LightingBlock des shaders.
+struct DirectionalLight
+{
+    glm::vec4 ambient;   // vec3, but padded
+    glm::vec4 diffuse;   // vec3, but padded
+    glm::vec4 specular;  // vec3, but padded
+    glm::vec4 direction; // vec3, but padded
+};
+
+struct SpotLight
+{
+    glm::vec4 ambient;   // vec3, but padded
+    glm::vec4 diffuse;   // vec3, but padded
+    glm::vec4 specular;  // vec3, but padded
+
+    glm::vec4 position;  // vec3, but padded
+    glm::vec3 direction;
+    GLfloat exponent;
+    GLfloat openingAngle;
+    GLfloat range;       // Distance où la contribution s'annule, borne le volume du projecteur.
+
+    GLfloat padding[2];
+};
+
+// Projecteurs qui peuvent atteindre un dessin, écrits avec ses transformations dans le TransformRing.
+const int MAX_DRAW_LIGHTS = 7;
+
+struct DrawLights
+{
+    int count; // -1 si la liste a débordé, le shader se sert alors de la grappe.
+    GLuint indices[MAX_DRAW_LIGHTS];
+};
+
+struct LightingData
+{
+    DirectionalLight dirLight;
+    // Somme des termes ambiants des projecteurs: ils éclairent partout, même hors de leur grappe.
+    glm::vec4 spotAmbient;
+    SpotLight spotLights[MAX_SPOT_LIGHTS];
+};
@@ -19,12 +19,22 @@
 #include <inf2705/OpenGLApplication.hpp>
 #include <inf2705/utils.hpp>
 
+#include "light_clusters.hpp"
+#include "light_manager.hpp"
+#include "material.hpp"
 #include "model.hpp"
+#include "render_queue.hpp"
+#include "screen_outline.hpp"
+#include "weighted_transparency.hpp"
 #include "car.hpp"
+#include "asset_pool.hpp"
+#include "gl_state.hpp"
 
 #include "model_data.hpp"
+#include "shader_watcher.hpp"
 #include "shaders.hpp"
 #include "textures.hpp"
+#include "transform_ring.hpp"
 #include "uniform_buffer.hpp"
 
 #define CHECK_GL_ERROR printGLError(__FILE__, __LINE__)
@@ -37,37 +47,6 @@ struct Vertex {
     vec3 color;
 };
 
-struct Material
-{
-    glm::vec4 emission; // vec3, but padded
-    glm::vec4 ambient;  // vec3, but padded
-    glm::vec4 diffuse;  // vec3, but padded
-    glm::vec3 specular;
-    GLfloat shininess;
-};
-
-struct DirectionalLight
-{
-    glm::vec4 ambient;   // vec3, but padded
-    glm::vec4 diffuse;   // vec3, but padded
-    glm::vec4 specular;  // vec3, but padded    
-    glm::vec4 direction; // vec3, but padded
-};
-
-struct SpotLight
-{
-    glm::vec4 ambient;   // vec3, but padded
-    glm::vec4 diffuse;   // vec3, but padded
-    glm::vec4 specular;  // vec3, but padded
-
-    glm::vec4 position;  // vec3, but padded
-    glm::vec3 direction;
-    GLfloat exponent;
-    GLfloat openingAngle;
-
-    GLfloat padding[3];
-};
-
 // Matériels
 
 Material defaultMat =
@@ -132,6 +111,10 @@ struct App : public OpenGLApplication
         , cameraOrientation_(0.f, 0.f)
         , currentScene_(0)
         , isMouseMotionEnabled_(false)
+        , lodPixelError_(1.0f)
+        , isScreenSpaceOutline_(false)
+        , nVisibleObjects_(0)
+        , nCulledObjects_(0)
     {
     }
 
@@ -163,73 +146,112 @@ struct App : public OpenGLApplication
 		edgeEffectShader_.create();
 		celShadingShader_.create();
 		skyShader_.create();
+        edgeDetectionShader_.create();
+        transparencyCompositeShader_.create();
+        shaderWatcher_.watch("./shaders");
+
+        transforms_.create(MAX_DRAWS_PER_FRAME);
+        lightClusters_.create();
+        lights_.create(1, N_SPOT_LIGHTS);
+        car_.transforms = &transforms_;
+        car_.lights = &lights_;
+        car_.texture = &carTexture_;
+        car_.windowTexture = &carWindowTexture_;
+
+        renderQueue_.celShadingShader = &celShadingShader_;
+        renderQueue_.edgeEffectShader = &edgeEffectShader_;
+        renderQueue_.skyShader = &skyShader_;
+        renderQueue_.materials = &materials_;
+        renderQueue_.lights = &lights_;
+        renderQueue_.transparency = &transparency_;
+        renderQueue_.transparencyCompositeShader = &transparencyCompositeShader_;
+        renderQueue_.transforms = &transforms_;
+
+        // Le décodage des images et des maillages se fait en parallèle, seuls les
+        // envois au GPU restent sur ce thread.
+        AssetJobPool assetPool;
+        AssetLoader loader(assetPool);
+
+        loader.addTexture(streetTexture_, "../textures/street.jpg");
+        loader.addTexture(grassTexture_, "../textures/grass.jpg");
+        loader.addTexture(treeTexture_, "../textures/tree.jpg");
+        loader.addTexture(streetlightTexture_, "../textures/streetlight.jpg");
+        loader.addTexture(streetlightLightTexture_, "../textures/streetlight_light.png");
+        loader.addTexture(carTexture_, "../textures/car.png");
+        loader.addTexture(carWindowTexture_, "../textures/window.png");
 
-        car_.edgeEffectShader = &edgeEffectShader_;
-        car_.celShadingShader = &celShadingShader_;
-        car_.material = &material_;
+        // TODO: Chargement des deux skyboxes.
 
-        streetTexture_.load("../textures/street.jpg");
+        const char* pathes[] = {
+            "../textures/skybox/Daylight Box_Right.bmp",
+            "../textures/skybox/Daylight Box_Left.bmp",
+            "../textures/skybox/Daylight Box_Top.bmp",
+            "../textures/skybox/Daylight Box_Bottom.bmp",
+            "../textures/skybox/Daylight Box_Front.bmp",
+            "../textures/skybox/Daylight Box_Back.bmp",
+        };
+
+        const char* nightPathes[] = {
+            "../textures/skyboxNight/right.png",
+            "../textures/skyboxNight/left.png",
+            "../textures/skyboxNight/top.png",
+            "../textures/skyboxNight/bottom.png",
+            "../textures/skyboxNight/front.png",
+            "../textures/skyboxNight/back.png",
+        };
+
+		loader.addCubeMap(skyboxTexture_, pathes);
+		loader.addCubeMap(skyboxNightTexture_, nightPathes);
+
+        loadModels(loader);
+        loader.finish();
+
+        streetTexture_.use();
 		streetTexture_.setWrap(GL_REPEAT);
 		streetTexture_.setFiltering(GL_LINEAR);
 		streetTexture_.enableMipmap();
 		
-        grassTexture_.load("../textures/grass.jpg");
+        grassTexture_.use();
 		grassTexture_.setWrap(GL_REPEAT);
 		grassTexture_.setFiltering(GL_LINEAR);
 		grassTexture_.enableMipmap();
 
-		treeTexture_.load("../textures/tree.jpg");
+		treeTexture_.use();
 		treeTexture_.setWrap(GL_REPEAT);
 		treeTexture_.setFiltering(GL_NEAREST);
 
-		streetlightTexture_.load("../textures/streetlight.jpg");
+		streetlightTexture_.use();
 		streetlightTexture_.setWrap(GL_REPEAT);
 		streetlightTexture_.setFiltering(GL_LINEAR);
 
-        streetlightLightTexture_.load("../textures/streetlight_light.png");
+        streetlightLightTexture_.use();
 		streetlightLightTexture_.setWrap(GL_CLAMP_TO_EDGE);
 		streetlightLightTexture_.setFiltering(GL_NEAREST);
 
-		carTexture_.load("../textures/car.png");
+		carTexture_.use();
 		carTexture_.setWrap(GL_CLAMP_TO_EDGE);
 		carTexture_.setFiltering(GL_LINEAR);
 
-		carWindowTexture_.load("../textures/window.png");
+		carWindowTexture_.use();
 		carWindowTexture_.setWrap(GL_CLAMP_TO_EDGE);
 		carWindowTexture_.setFiltering(GL_NEAREST);
 
-        // TODO: Chargement des deux skyboxes.
-
-        const char* pathes[] = {
-            "../textures/skybox/Daylight Box_Right.bmp",
-            "../textures/skybox/Daylight Box_Left.bmp",
-            "../textures/skybox/Daylight Box_Top.bmp",
-            "../textures/skybox/Daylight Box_Bottom.bmp",
-            "../textures/skybox/Daylight Box_Front.bmp",
-            "../textures/skybox/Daylight Box_Back.bmp",
-        };
-
-        const char* nightPathes[] = {
-            "../textures/skyboxNight/right.png",
-            "../textures/skyboxNight/left.png",
-            "../textures/skyboxNight/top.png",
-            "../textures/skyboxNight/bottom.png",
-            "../textures/skyboxNight/front.png",
-            "../textures/skyboxNight/back.png",
-        };
-
-		skyboxTexture_.load(pathes);
-		skyboxNightTexture_.load(nightPathes);
-
-        loadModels();
         initStaticModelMatrices();
 
         // Partie 3
 
-        material_.allocate(&defaultMat, sizeof(Material));
-        material_.setBindingIndex(0);
-
-        lightsData_.dirLight =
+        defaultMatId_ = materials_.add(defaultMat);
+        grassMatId_ = materials_.add(grassMat);
+        streetMatId_ = materials_.add(streetMat);
+        streetlightMatId_ = materials_.add(streetlightMat);
+        streetlightLightMatId_ = materials_.add(streetlightLightMat);
+        windowMatId_ = materials_.add(windowMat);
+        car_.bodyMaterial = defaultMatId_;
+        car_.windowMaterial = windowMatId_;
+        car_.registerMaterials(materials_);
+        materials_.upload(0);
+
+        lights_.getDirectionalLight() =
         {
             {0.2f, 0.2f, 0.2f, 0.0f},
             {1.0f, 1.0f, 1.0f, 0.0f},
@@ -239,33 +261,38 @@ struct App : public OpenGLApplication
 
         for (unsigned int i = 0; i < N_STREETLIGHTS; i++)
         {
-            lightsData_.spotLights[i].position = glm::vec4(streetlightLightPositions[i], 0.0f);
-            lightsData_.spotLights[i].direction = glm::vec3(0, -1, 0);
-            lightsData_.spotLights[i].exponent = 6.0f;
-            lightsData_.spotLights[i].openingAngle = 60.f;
+            lights_.getSpotLight(i).position = glm::vec4(streetlightLightPositions[i], 0.0f);
+            lights_.getSpotLight(i).direction = glm::vec3(0, -1, 0);
+            lights_.getSpotLight(i).exponent = 6.0f;
+            lights_.getSpotLight(i).openingAngle = 60.f;
+            lights_.getSpotLight(i).range = STREETLIGHT_RANGE;
         }
 
         // Initialisation des paramètres de lumière des phares
 
-        lightsData_.spotLights[N_STREETLIGHTS].position = glm::vec4(-1.6, 0.64, -0.45, 0.0f);
-        lightsData_.spotLights[N_STREETLIGHTS].direction = glm::vec3(-10, -1, 0);
-        lightsData_.spotLights[N_STREETLIGHTS].exponent = 4.0f;
-        lightsData_.spotLights[N_STREETLIGHTS].openingAngle = 30.f;
+        lights_.getSpotLight(N_STREETLIGHTS).position = glm::vec4(-1.6, 0.64, -0.45, 0.0f);
+        lights_.getSpotLight(N_STREETLIGHTS).direction = glm::vec3(-10, -1, 0);
+        lights_.getSpotLight(N_STREETLIGHTS).exponent = 4.0f;
+        lights_.getSpotLight(N_STREETLIGHTS).openingAngle = 30.f;
+        lights_.getSpotLight(N_STREETLIGHTS).range = HEADLIGHT_RANGE;
 
-        lightsData_.spotLights[N_STREETLIGHTS + 1].position = glm::vec4(-1.6, 0.64, 0.45, 0.0f);
-        lightsData_.spotLights[N_STREETLIGHTS + 1].direction = glm::vec3(-10, -1, 0);
-        lightsData_.spotLights[N_STREETLIGHTS + 1].exponent = 4.0f;
-        lightsData_.spotLights[N_STREETLIGHTS + 1].openingAngle = 30.f;
+        lights_.getSpotLight(N_STREETLIGHTS + 1).position = glm::vec4(-1.6, 0.64, 0.45, 0.0f);
+        lights_.getSpotLight(N_STREETLIGHTS + 1).direction = glm::vec3(-10, -1, 0);
+        lights_.getSpotLight(N_STREETLIGHTS + 1).exponent = 4.0f;
+        lights_.getSpotLight(N_STREETLIGHTS + 1).openingAngle = 30.f;
+        lights_.getSpotLight(N_STREETLIGHTS + 1).range = HEADLIGHT_RANGE;
 
-        lightsData_.spotLights[N_STREETLIGHTS + 2].position = glm::vec4(1.6, 0.64, -0.45, 0.0f);
-        lightsData_.spotLights[N_STREETLIGHTS + 2].direction = glm::vec3(10, -1, 0);
-        lightsData_.spotLights[N_STREETLIGHTS + 2].exponent = 4.0f;
-        lightsData_.spotLights[N_STREETLIGHTS + 2].openingAngle = 60.f;
+        lights_.getSpotLight(N_STREETLIGHTS + 2).position = glm::vec4(1.6, 0.64, -0.45, 0.0f);
+        lights_.getSpotLight(N_STREETLIGHTS + 2).direction = glm::vec3(10, -1, 0);
+        lights_.getSpotLight(N_STREETLIGHTS + 2).exponent = 4.0f;
+        lights_.getSpotLight(N_STREETLIGHTS + 2).openingAngle = 60.f;
+        lights_.getSpotLight(N_STREETLIGHTS + 2).range = BRAKE_LIGHT_RANGE;
 
-        lightsData_.spotLights[N_STREETLIGHTS + 3].position = glm::vec4(1.6, 0.64, 0.45, 0.0f);
-        lightsData_.spotLights[N_STREETLIGHTS + 3].direction = glm::vec3(10, -1, 0);
-        lightsData_.spotLights[N_STREETLIGHTS + 3].exponent = 4.0f;
-        lightsData_.spotLights[N_STREETLIGHTS + 3].openingAngle = 60.f;
+        lights_.getSpotLight(N_STREETLIGHTS + 3).position = glm::vec4(1.6, 0.64, 0.45, 0.0f);
+        lights_.getSpotLight(N_STREETLIGHTS + 3).direction = glm::vec3(10, -1, 0);
+        lights_.getSpotLight(N_STREETLIGHTS + 3).exponent = 4.0f;
+        lights_.getSpotLight(N_STREETLIGHTS + 3).openingAngle = 60.f;
+        lights_.getSpotLight(N_STREETLIGHTS + 3).range = BRAKE_LIGHT_RANGE;
 
 
         toggleStreetlight();
@@ -273,15 +300,13 @@ struct App : public OpenGLApplication
 
         setLightingUniform();
 
-        lights_.allocate(&lightsData_, sizeof(lightsData_));
-        lights_.setBindingIndex(1);
-
         CHECK_GL_ERROR;
     }
 
     void drawFrame() override
     {
         CHECK_GL_ERROR;
+        GLStateCache::get().beginFrame();
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
         ImGui::Begin("Scene Parameters");
@@ -290,13 +315,32 @@ struct App : public OpenGLApplication
         if (ImGui::Button("Reload Shaders"))
         {
             CHECK_GL_ERROR;
-            edgeEffectShader_.reload();
-            celShadingShader_.reload();
-            skyShader_.reload();
-
-            setLightingUniform();
+            for (ShaderProgram* shader : getShaderPrograms())
+                shader->reload();
             CHECK_GL_ERROR;
         }
+
+        // Seuls les programmes dont un étage a été modifié sur le disque sont recompilés.
+        std::vector<std::string> changedShaderFiles = shaderWatcher_.poll();
+        if (!changedShaderFiles.empty())
+        {
+            for (ShaderProgram* shader : getShaderPrograms())
+                shader->reloadChangedFiles(changedShaderFiles);
+        }
+
+        // Les programmes rechargés remplacent les anciens une fois liés, sans bloquer l'image.
+        // Ils reçoivent alors les uniformes gardés par leur classe (restoreUniforms()).
+        bool isReloading = false;
+        for (ShaderProgram* shader : getShaderPrograms())
+        {
+            shader->pollReload();
+            isReloading |= shader->isReloading();
+        }
+        if (isReloading)
+        {
+            ImGui::SameLine();
+            ImGui::Text("Compiling...");
+        }
         ImGui::End();
 
         switch (currentScene_)
@@ -308,6 +352,10 @@ struct App : public OpenGLApplication
 
     void onClose() override
     {
+        transparency_.release();
+        screenOutline_.release();
+        transforms_.release();
+        MeshPool::releaseAll();
     }
 
     void onKeyPress(const sf::Event::KeyPressed& key) override
@@ -404,13 +452,13 @@ struct App : public OpenGLApplication
         cameraPosition_ += positionOffset * glm::vec3(deltaTime_);
     }
 
-    void loadModels()
+    void loadModels(AssetLoader& loader)
     {
-        car_.loadModels();
-        tree_.load("../models/tree.ply");
-        streetlight_.load("../models/streetlight.ply");
-        streetlightLight_.load("../models/streetlight_light.ply");
-        skybox_.load("../models/skybox.ply");
+        car_.loadModels(loader);
+        loader.addModel(tree_, "../models/tree.ply");
+        loader.addModel(streetlight_, "../models/streetlight.ply");
+        loader.addModel(streetlightLight_, "../models/streetlight_light.ply");
+        loader.addModel(skybox_, "../models/skybox.ply");
 
 		grass_.load(ground, sizeof(ground), planeElements, sizeof(planeElements));
 		street_.load(street, sizeof(street), planeElements, sizeof(planeElements));
@@ -418,6 +466,10 @@ struct App : public OpenGLApplication
 
     void initStaticModelMatrices()
     {
+        streetModel_ = scale(mat4(1.0f), vec3(100.0f, 1.0f, 5.0f));
+        grassModel_ = translate(mat4(1.0f), vec3(0.0f, -0.1f, 0.0f));
+        grassModel_ = scale(grassModel_, vec3(100.0f, 1.0f, 50.0f));
+
         auto randBetween = [](float min, float max) {
             return float(min + rand01() * (max - min));
 		};
@@ -461,90 +513,78 @@ struct App : public OpenGLApplication
 			streetlightModelMatrices_[i] = model;
             streetlightLightPositions[i] = glm::vec3(streetlightModelMatrices_[i] * glm::vec4(-2.77, 5.2, 0.0, 1.0));
         }
+
+        tree_.setInstanceMatrices(treeModelMatrices_, N_TREES);
+        streetlight_.setInstanceMatrices(streetlightModelMatrices_, N_STREETLIGHTS);
+        streetlightLight_.setInstanceMatrices(streetlightModelMatrices_, N_STREETLIGHTS);
     }
 
-    void drawStreetlights(glm::mat4& projView, glm::mat4& view)
+    void submitOutlinedInstances(Model& model, Texture2D& texture, MaterialHandle material)
     {
-        for (unsigned int i = 0; i < N_STREETLIGHTS; i++)
-        {
-            mat4 model = streetlightModelMatrices_[i];
-            mat4 mvp = projView * model;
+        if (model.getVisibleInstanceCount() == 0)
+            return;
 
-            if (!isDay_)
-                setMaterial(streetlightLightMat);
-            else
-                setMaterial(streetlightMat);
-            streetlightLightTexture_.use();
-            celShadingShader_.use();
-			celShadingShader_.setMatrices(mvp, view, streetlightModelMatrices_[i]);
-			streetlightLight_.draw();
-
-            setMaterial(streetlightMat);
-            glEnable(GL_STENCIL_TEST);
-            glStencilFunc(GL_ALWAYS, 2, 0xFF);
-            glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-			streetlightTexture_.use();
-            celShadingShader_.use();
-            celShadingShader_.setMatrices(mvp, view, streetlightModelMatrices_[i]);
-			streetlight_.draw();
-
-            glStencilFunc(GL_NOTEQUAL, 2, 0xFF);
-            glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
-			edgeEffectShader_.use();
-			glUniformMatrix4fv(edgeEffectShader_.mvpULoc, 1, GL_FALSE, glm::value_ptr(mvp));
-            streetlight_.draw();
-			glDisable(GL_STENCIL_TEST);
-        }
+        DrawPacket packet = {};
+        packet.model = &model;
+        packet.isInstanced = true;
+        packet.texture = &texture;
+        packet.material = material;
+        // Les instances couvrent toute la scène, elles passent en premier.
+        renderQueue_.submitOutlined(RenderPass::Outlined, packet, 0, cameraPosition_);
     }
 
-    void drawTrees(glm::mat4& projView, glm::mat4& view)
+    void submitStreetlights()
     {
-        for (unsigned int i = 0; i < N_TREES; i++)
+        if (streetlightLight_.getVisibleInstanceCount() > 0)
         {
-            mat4 mvp = projView * treeModelMatrices_[i];
-
-            glEnable(GL_STENCIL_TEST);
-            glStencilFunc(GL_ALWAYS, 2, 0xFF);
-            glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-            treeTexture_.use();
-            celShadingShader_.use();
-			celShadingShader_.setMatrices(mvp, view, treeModelMatrices_[i]);
-			tree_.draw();
-
-            glStencilFunc(GL_NOTEQUAL, 2, 0xFF);
-            glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
-			edgeEffectShader_.use();
-            glUniformMatrix4fv(edgeEffectShader_.mvpULoc, 1, GL_FALSE, glm::value_ptr(mvp));
-			tree_.draw();
-			glDisable(GL_STENCIL_TEST);
+            DrawPacket packet = {};
+            packet.model = &streetlightLight_;
+            packet.isInstanced = true;
+            packet.shader = RenderShader::CelShading;
+            packet.texture = &streetlightLightTexture_;
+            packet.material = isDay_ ? streetlightMatId_ : streetlightLightMatId_;
+            renderQueue_.submit(RenderPass::Opaque, packet, cameraPosition_);
         }
+
+        submitOutlinedInstances(streetlight_, streetlightTexture_, streetlightMatId_);
     }
 
-    void drawGround(glm::mat4& projView, glm::mat4& view)
+    void submitTrees()
     {
-        setMaterial(streetMat);
-        {
-            mat4 model = mat4(1.0f);
-            model = scale(model, vec3(100.0f, 1.0f, 5.0f));
-            mat4 mvp = projView * model;
+        submitOutlinedInstances(tree_, treeTexture_, grassMatId_);
+    }
+
+    void countCulling(unsigned int nVisible, unsigned int nTotal)
+    {
+        nVisibleObjects_ += nVisible;
+        nCulledObjects_ += nTotal - nVisible;
+    }
+
+    void submitGround(const Frustum& frustum)
+    {
+        DrawPacket packet = {};
+        packet.shader = RenderShader::CelShading;
 
-			streetTexture_.use();
-			celShadingShader_.use();
-			celShadingShader_.setMatrices(mvp, view, model);
-			street_.draw();
+        bool isStreetVisible = street_.isVisible(streetModel_, frustum);
+        countCulling(isStreetVisible ? 1 : 0, 1);
+        if (isStreetVisible)
+        {
+            packet.model = &street_;
+            packet.drawId = streetDrawId_;
+            packet.texture = &streetTexture_;
+            packet.material = streetMatId_;
+            renderQueue_.submit(RenderPass::Opaque, packet, vec3(streetModel_[3]));
         }
 
-        setMaterial(grassMat);       
-        {   
-            mat4 model = mat4(1.0f);
-			model = translate(model, vec3(0.0f, -0.1f, 0.0f));
-            model = scale(model, vec3(100.0f, 1.0f, 50.0f));
-			mat4 mvp = projView * model;
-
-            grassTexture_.use();
-			celShadingShader_.use();
-			celShadingShader_.setMatrices(mvp, view, model);
-			grass_.draw();
+        bool isGrassVisible = grass_.isVisible(grassModel_, frustum);
+        countCulling(isGrassVisible ? 1 : 0, 1);
+        if (isGrassVisible)
+        {
+            packet.model = &grass_;
+            packet.drawId = grassDrawId_;
+            packet.texture = &grassTexture_;
+            packet.material = grassMatId_;
+            renderQueue_.submit(RenderPass::Opaque, packet, vec3(grassModel_[3]));
         }
     }
 
@@ -559,60 +599,76 @@ struct App : public OpenGLApplication
         return view;
     }
 
+    std::array<ShaderProgram*, 5> getShaderPrograms()
+    {
+        return { &edgeEffectShader_, &celShadingShader_, &skyShader_, &edgeDetectionShader_, &transparencyCompositeShader_ };
+    }
+
     void setLightingUniform()
     {
         celShadingShader_.use();
-        glUniform1i(celShadingShader_.nSpotLightsULoc, N_STREETLIGHTS + 4);
 
         float ambientIntensity = 0.05;
-        glUniform3f(celShadingShader_.globalAmbientULoc, ambientIntensity, ambientIntensity, ambientIntensity);
+        celShadingShader_.setGlobalAmbient(vec3(ambientIntensity));
     }
 
     void toggleSun()
     {
         if (isDay_)
         {
-            lightsData_.dirLight.ambient = glm::vec4(0.2f, 0.2f, 0.2f, 0.0f);
-            lightsData_.dirLight.diffuse = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
-            lightsData_.dirLight.specular = glm::vec4(0.5f, 0.5f, 0.5f, 0.0f);
+            lights_.getDirectionalLight().ambient = glm::vec4(0.2f, 0.2f, 0.2f, 0.0f);
+            lights_.getDirectionalLight().diffuse = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+            lights_.getDirectionalLight().specular = glm::vec4(0.5f, 0.5f, 0.5f, 0.0f);
         }
         else
         {
-            lightsData_.dirLight.ambient = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
-            lightsData_.dirLight.diffuse = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
-            lightsData_.dirLight.specular = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+            lights_.getDirectionalLight().ambient = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+            lights_.getDirectionalLight().diffuse = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+            lights_.getDirectionalLight().specular = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
         }
     }
 
     glm::mat4 getPerspectiveProjectionMatrix()
     {
-        float fov = radians(70.0f);
+        float fov = radians(CAMERA_FOV_DEGREES);
         sf::Vector2u windowSize = window_.getSize();
 		float aspectRatio = (float)windowSize.x / (float)windowSize.y;
-        float near = 0.1f;
-        float far = 100.0f;
+        float near = CAMERA_NEAR_PLANE;
+        float far = CAMERA_FAR_PLANE;
 
 		return glm::perspective(fov, aspectRatio, near, far);
     }
 
+    LodSelection getLodSelection()
+    {
+        sf::Vector2u windowSize = window_.getSize();
+        float fov = radians(CAMERA_FOV_DEGREES);
+
+        LodSelection selection;
+        selection.cameraPosition = cameraPosition_;
+        selection.pixelsPerUnit = (float)windowSize.y / (2.0f * tan(fov / 2.0f));
+        selection.maxPixelError = lodPixelError_;
+        return selection;
+    }
+
     void toggleStreetlight()
     {
         if (isDay_)
         {
             for (unsigned int i = 0; i < N_STREETLIGHTS; i++)
             {
-                lightsData_.spotLights[i].ambient = glm::vec4(glm::vec3(0.0f), 0.0f);
-                lightsData_.spotLights[i].diffuse = glm::vec4(glm::vec3(0.0f), 0.0f);
-                lightsData_.spotLights[i].specular = glm::vec4(glm::vec3(0.0f), 0.0f);
+                lights_.getSpotLight(i).ambient = glm::vec4(glm::vec3(0.0f), 0.0f);
+                lights_.getSpotLight(i).diffuse = glm::vec4(glm::vec3(0.0f), 0.0f);
+                lights_.getSpotLight(i).specular = glm::vec4(glm::vec3(0.0f), 0.0f);
             }
         }
         else
         {
             for (unsigned int i = 0; i < N_STREETLIGHTS; i++)
             {
-                lightsData_.spotLights[i].ambient = glm::vec4(glm::vec3(0.02f), 0.0f);
-                lightsData_.spotLights[i].diffuse = glm::vec4(glm::vec3(0.8f), 0.0f);
-                lightsData_.spotLights[i].specular = glm::vec4(glm::vec3(0.4f), 0.0f);
+                lights_.getSpotLight(i).ambient = glm::vec4(glm::vec3(0.02f), 0.0f);
+                lights_.getSpotLight(i).diffuse = glm::vec4(glm::vec3(0.8f), 0.0f);
+                lights_.getSpotLight(i).specular = glm::vec4(glm::vec3(0.4f), 0.0f);
             
             }
         }
@@ -622,75 +678,76 @@ struct App : public OpenGLApplication
     {
         if (car_.isHeadlightOn)
         {
-            lightsData_.spotLights[N_STREETLIGHTS].ambient = glm::vec4(glm::vec3(0.01), 0.0f);
-            lightsData_.spotLights[N_STREETLIGHTS].diffuse = glm::vec4(glm::vec3(1.0), 0.0f);
-            lightsData_.spotLights[N_STREETLIGHTS].specular = glm::vec4(glm::vec3(0.4), 0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS).ambient = glm::vec4(glm::vec3(0.01), 0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS).diffuse = glm::vec4(glm::vec3(1.0), 0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS).specular = glm::vec4(glm::vec3(0.4), 0.0f);
 
-            lightsData_.spotLights[N_STREETLIGHTS + 1].ambient = glm::vec4(glm::vec3(0.01), 0.0f);
-            lightsData_.spotLights[N_STREETLIGHTS + 1].diffuse = glm::vec4(glm::vec3(1.0), 0.0f);
-            lightsData_.spotLights[N_STREETLIGHTS + 1].specular = glm::vec4(glm::vec3(0.4), 0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 1).ambient = glm::vec4(glm::vec3(0.01), 0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 1).diffuse = glm::vec4(glm::vec3(1.0), 0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 1).specular = glm::vec4(glm::vec3(0.4), 0.0f);
 
-            lightsData_.spotLights[N_STREETLIGHTS].position = vec4(car_.carModel * glm::vec4(-1.6, 0.64, -0.45, 1.0f));
-            lightsData_.spotLights[N_STREETLIGHTS].direction = vec3(car_.carModel * glm::vec4(-10, -1, 0, 0));
+            lights_.getSpotLight(N_STREETLIGHTS).position = vec4(car_.carModel * glm::vec4(-1.6, 0.64, -0.45, 1.0f));
+            lights_.getSpotLight(N_STREETLIGHTS).direction = vec3(car_.carModel * glm::vec4(-10, -1, 0, 0));
 
-            lightsData_.spotLights[N_STREETLIGHTS + 1].position = vec4(car_.carModel * glm::vec4(-1.6, 0.64, 0.45, 1.0f));
-            lightsData_.spotLights[N_STREETLIGHTS + 1].direction = vec3(car_.carModel * glm::vec4(-10, -1, 0, 0));
+            lights_.getSpotLight(N_STREETLIGHTS + 1).position = vec4(car_.carModel * glm::vec4(-1.6, 0.64, 0.45, 1.0f));
+            lights_.getSpotLight(N_STREETLIGHTS + 1).direction = vec3(car_.carModel * glm::vec4(-10, -1, 0, 0));
         }
         else
         {
-            lightsData_.spotLights[N_STREETLIGHTS].ambient = glm::vec4(0.0f);
-            lightsData_.spotLights[N_STREETLIGHTS].diffuse = glm::vec4(0.0f);
-            lightsData_.spotLights[N_STREETLIGHTS].specular = glm::vec4(0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS).ambient = glm::vec4(0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS).diffuse = glm::vec4(0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS).specular = glm::vec4(0.0f);
 
-            lightsData_.spotLights[N_STREETLIGHTS + 1].ambient = glm::vec4(0.0f);
-            lightsData_.spotLights[N_STREETLIGHTS + 1].diffuse = glm::vec4(0.0f);
-            lightsData_.spotLights[N_STREETLIGHTS + 1].specular = glm::vec4(0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 1).ambient = glm::vec4(0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 1).diffuse = glm::vec4(0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 1).specular = glm::vec4(0.0f);
         }
 
         if (car_.isBraking)
         {
-            lightsData_.spotLights[N_STREETLIGHTS + 2].ambient = glm::vec4(0.01, 0.0, 0.0, 0.0f);
-            lightsData_.spotLights[N_STREETLIGHTS + 2].diffuse = glm::vec4(0.9, 0.1, 0.1, 0.0f);
-            lightsData_.spotLights[N_STREETLIGHTS + 2].specular = glm::vec4(0.35, 0.05, 0.05, 0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 2).ambient = glm::vec4(0.01, 0.0, 0.0, 0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 2).diffuse = glm::vec4(0.9, 0.1, 0.1, 0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 2).specular = glm::vec4(0.35, 0.05, 0.05, 0.0f);
 
-            lightsData_.spotLights[N_STREETLIGHTS + 3].ambient = glm::vec4(0.01, 0.0, 0.0, 0.0f);
-            lightsData_.spotLights[N_STREETLIGHTS + 3].diffuse = glm::vec4(0.9, 0.1, 0.1, 0.0f);
-            lightsData_.spotLights[N_STREETLIGHTS + 3].specular = glm::vec4(0.35, 0.05, 0.05, 0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 3).ambient = glm::vec4(0.01, 0.0, 0.0, 0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 3).diffuse = glm::vec4(0.9, 0.1, 0.1, 0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 3).specular = glm::vec4(0.35, 0.05, 0.05, 0.0f);
 
-            lightsData_.spotLights[N_STREETLIGHTS + 2].position = vec4(car_.carModel * glm::vec4(1.6, 0.64, -0.45, 1.0f));
-            lightsData_.spotLights[N_STREETLIGHTS + 2].direction = vec3(car_.carModel * glm::vec4(10, -1, 0, 0));
+            lights_.getSpotLight(N_STREETLIGHTS + 2).position = vec4(car_.carModel * glm::vec4(1.6, 0.64, -0.45, 1.0f));
+            lights_.getSpotLight(N_STREETLIGHTS + 2).direction = vec3(car_.carModel * glm::vec4(10, -1, 0, 0));
 
-            lightsData_.spotLights[N_STREETLIGHTS + 3].position = vec4(car_.carModel * glm::vec4(1.6, 0.64, 0.45, 1.0f));
-            lightsData_.spotLights[N_STREETLIGHTS + 3].direction = vec3(car_.carModel * glm::vec4(10, -1, 0, 0));
+            lights_.getSpotLight(N_STREETLIGHTS + 3).position = vec4(car_.carModel * glm::vec4(1.6, 0.64, 0.45, 1.0f));
+            lights_.getSpotLight(N_STREETLIGHTS + 3).direction = vec3(car_.carModel * glm::vec4(10, -1, 0, 0));
         }
         else
         {
-            lightsData_.spotLights[N_STREETLIGHTS + 2].ambient = glm::vec4(0.0f);
-            lightsData_.spotLights[N_STREETLIGHTS + 2].diffuse = glm::vec4(0.0f);
-            lightsData_.spotLights[N_STREETLIGHTS + 2].specular = glm::vec4(0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 2).ambient = glm::vec4(0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 2).diffuse = glm::vec4(0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 2).specular = glm::vec4(0.0f);
 
-            lightsData_.spotLights[N_STREETLIGHTS + 3].ambient = glm::vec4(0.0f);
-            lightsData_.spotLights[N_STREETLIGHTS + 3].diffuse = glm::vec4(0.0f);
-            lightsData_.spotLights[N_STREETLIGHTS + 3].specular = glm::vec4(0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 3).ambient = glm::vec4(0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 3).diffuse = glm::vec4(0.0f);
+            lights_.getSpotLight(N_STREETLIGHTS + 3).specular = glm::vec4(0.0f);
         }
     }
 
-    void drawSkybox(glm::mat4& proj, glm::mat4& view)
+    // Dessiné après les opaques: la position est projetée en z = w, le test GL_LEQUAL
+    // ne garde que les pixels encore vides.
+    void submitSkybox(glm::mat4& proj, glm::mat4& view)
     {
         mat4 mvp = proj * mat4(mat3(view));
 
-        glDepthFunc(GL_LEQUAL);
         skyShader_.use();
         glUniformMatrix4fv(skyShader_.mvpULoc, 1, GL_FALSE, glm::value_ptr(mvp));
         glUniform1i(skyShader_.textureSamplerULoc, 0);
-        skybox_.draw();
-        glDepthFunc(GL_LESS);
-	}
 
-    void setMaterial(Material& mat)
-    {
-        material_.updateData(&mat, 0, sizeof(Material));
-    }
+        DrawPacket packet = {};
+        packet.model = &skybox_;
+        packet.shader = RenderShader::Sky;
+        packet.cubeMap = isDay_ ? &skyboxTexture_ : &skyboxNightTexture_;
+        packet.state = STATE_DEPTH_LEQUAL;
+        renderQueue_.submit(RenderPass::Sky, packet, cameraPosition_);
+	}
 
     void sceneMain()
     {
@@ -700,7 +757,6 @@ struct App : public OpenGLApplication
             isDay_ = !isDay_;
             toggleSun();
             toggleStreetlight();
-            lights_.updateData(&lightsData_, 0, sizeof(DirectionalLight) + N_STREETLIGHTS * sizeof(SpotLight));
         }
         ImGui::SliderFloat("Car Speed", &car_.speed, -10.0f, 10.0f, "%.2f m/s");
         ImGui::SliderFloat("Steering Angle", &car_.steeringAngle, -30.0f, 30.0f, "%.2f°");
@@ -710,40 +766,92 @@ struct App : public OpenGLApplication
         ImGui::Checkbox("Left Blinker", &car_.isLeftBlinkerActivated);
         ImGui::Checkbox("Right Blinker", &car_.isRightBlinkerActivated);
         ImGui::Checkbox("Brake", &car_.isBraking);
+        ImGui::Checkbox("Screen-Space Outlines", &isScreenSpaceOutline_);
+        ImGui::SliderFloat("LOD Pixel Error", &lodPixelError_, 0.0f, 8.0f, "%.1f px");
+        ImGui::Text("Objects: %u visible, %u culled", nVisibleObjects_, nCulledObjects_);
+        const RenderQueueStats& queueStats = renderQueue_.getStats();
+        ImGui::Text("Draws: %u, program switches: %u", queueStats.draws, queueStats.programSwitches);
+        if (queueStats.skippedDraws)
+            ImGui::Text("Skipped draws (variant compiling or failed): %u", queueStats.skippedDraws);
+        ImGui::Text("State changes: %u sorted, %u in submit order (%d saved)", queueStats.stateChanges, queueStats.submitOrderChanges, queueStats.stateChangesSaved());
+        const GLStateCounters& glCounters = GLStateCache::get().getLastFrameCounters();
+        ImGui::Text("GL state calls: %u issued, %u skipped", glCounters.issued, glCounters.skipped);
+        ImGui::Text("Spot lights: %u of %u active, %u bytes uploaded", lights_.getActiveSpotLightCount(), lights_.getSpotLightCount(), lights_.getUploadedBytes());
+        ImGui::Text("Draw light culling: %u of %u light-draw pairs kept, %u lists overflowed",
+                    lights_.getDrawLightsKept(), lights_.getDrawLightTests(), lights_.getDrawLightOverflows());
+        ImGui::Text("Light clusters: %u light references, at most %u per cluster", lightClusters_.getIndexCount(), lightClusters_.getMaxLightsPerCluster());
         ImGui::End();
 
         updateCameraInput();
         car_.update(deltaTime_);
 
         updateCarLight();
-        lights_.updateData(&lightsData_.spotLights[N_STREETLIGHTS], sizeof(DirectionalLight) + N_STREETLIGHTS * sizeof(SpotLight), 4 * sizeof(SpotLight));
 
         glm::mat4 view = getViewMatrix();
         glm::mat4 proj = getPerspectiveProjectionMatrix();
         glm::mat4 projView = proj * view;
 
-        if (isDay_)
-            skyboxTexture_.use();
-        else
-			skyboxNightTexture_.use();
-		drawSkybox(proj, view);
+        lights_.update(view);
+
+        // Culling et niveaux de détail décidés une seule fois: la passe principale et celle
+        // du contour dessinent exactement les mêmes instances.
+        Frustum frustum = extractFrustum(projView);
+        LodSelection lodSelection = getLodSelection();
+        tree_.updateInstances(frustum, lodSelection);
+        streetlight_.updateInstances(frustum, lodSelection);
+        streetlightLight_.updateInstances(frustum, lodSelection);
+
+        nVisibleObjects_ = 0;
+        nCulledObjects_ = 0;
+        countCulling(tree_.getVisibleInstanceCount(), tree_.getInstanceCount());
+        countCulling(streetlight_.getVisibleInstanceCount(), streetlight_.getInstanceCount());
+
+        // Matrices par dessin écrites d'un bloc dans l'anneau, les matrices communes
+        // envoyées une seule fois par programme.
+        transforms_.beginFrame();
+        mat4 streetMvp = projView * streetModel_;
+        mat4 grassMvp = projView * grassModel_;
+        streetDrawId_ = transforms_.push(streetMvp, view, streetModel_, lights_.selectDrawLights(view * streetModel_, street_.getBounds()));
+        grassDrawId_ = transforms_.push(grassMvp, view, grassModel_, lights_.selectDrawLights(view * grassModel_, grass_.getBounds()));
+        car_.prepareTransforms(projView, view);
+        transforms_.endWrites();
 
-		drawGround(projView, view);
+        celShadingShader_.use();
+        celShadingShader_.setFrameMatrices(projView, view);
 
-        setMaterial(grassMat);
-		drawTrees(projView, view);
+        sf::Vector2u windowSize = window_.getSize();
+        lightClusters_.update(lights_.getActiveSpotLights(), lights_.getActiveSpotLightCount(), proj, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
+        lightClusters_.use(celShadingShader_, windowSize.x, windowSize.y);
 
-		setMaterial(streetlightMat);
-		drawStreetlights(projView, view);
+        edgeEffectShader_.use();
+        edgeEffectShader_.setFrameMatrices(projView);
 
-        setMaterial(defaultMat);
-		carTexture_.use();
-		car_.draw(projView, view);
+        // L'ordre des dessins et les changements d'état sont décidés par la clé de tri de chaque paquet.
+        renderQueue_.reset(cameraPosition_, CAMERA_FAR_PLANE);
+        renderQueue_.isEdgeEffectEnabled = !isScreenSpaceOutline_;
+        submitGround(frustum);
+        submitTrees();
+        submitStreetlights();
+
+        bool isCarVisible = car_.isVisible(frustum);
+        countCulling(isCarVisible ? 1 : 0, 1);
+        if (isCarVisible)
+            car_.submit(renderQueue_);
+
+        submitSkybox(proj, view);
+
+        // Toujours dans le FBO de la scène: la transparence partage sa profondeur-stencil.
+        screenOutline_.resize(windowSize.x, windowSize.y);
+        transparency_.resize(windowSize.x, windowSize.y, screenOutline_.getDepthStencilTexture());
+        screenOutline_.begin();
+
+        renderQueue_.sort();
+        renderQueue_.execute();
+
+        screenOutline_.end(edgeDetectionShader_, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE, isScreenSpaceOutline_);
+
+        transforms_.endFrame();
 
-        setMaterial(windowMat);
-		carWindowTexture_.use();
-		car_.drawWindows(projView, view);
-        
     }
 
 private:
@@ -751,6 +859,9 @@ private:
     EdgeEffect edgeEffectShader_;
     CelShading celShadingShader_;
     Sky skyShader_;
+    EdgeDetection edgeDetectionShader_;
+    TransparencyComposite transparencyCompositeShader_;
+    ShaderWatcher shaderWatcher_;
 
     // Textures
     Texture2D grassTexture_;
@@ -764,14 +875,15 @@ private:
     TextureCubeMap skyboxNightTexture_;
 
     // Uniform buffers
-    UniformBuffer material_;
-    UniformBuffer lights_;
-
-    struct {
-        DirectionalLight dirLight;
-        SpotLight spotLights[16];
-        //PointLight pointLights[4];
-    } lightsData_;
+    MaterialTable materials_;
+    MaterialHandle defaultMatId_;
+    MaterialHandle grassMatId_;
+    MaterialHandle streetMatId_;
+    MaterialHandle streetlightMatId_;
+    MaterialHandle streetlightLightMatId_;
+    MaterialHandle windowMatId_;
+    LightManager lights_;
+    LightClusters lightClusters_;
 
     bool isDay_;
 
@@ -785,11 +897,30 @@ private:
 
     Car car_;
 
+    static constexpr GLsizei MAX_DRAWS_PER_FRAME = 64;
+    TransformRing transforms_;
+    RenderQueue renderQueue_;
+    ScreenSpaceOutline screenOutline_;
+    WeightedTransparency transparency_;
+    glm::mat4 streetModel_;
+    glm::mat4 grassModel_;
+    GLuint streetDrawId_;
+    GLuint grassDrawId_;
+
     glm::vec3 cameraPosition_;
     glm::vec2 cameraOrientation_;
 
+    static constexpr float CAMERA_FOV_DEGREES = 70.0f;
+    static constexpr float CAMERA_NEAR_PLANE = 0.1f;
+    static constexpr float CAMERA_FAR_PLANE = 100.0f;
     static constexpr unsigned int N_TREES = 12;
     static constexpr unsigned int N_STREETLIGHTS = 5;
+    // Lampadaires, puis les phares et les feux de freinage de la voiture.
+    static constexpr unsigned int N_SPOT_LIGHTS = N_STREETLIGHTS + 4;
+    // Portées des projecteurs, en mètres.
+    static constexpr float STREETLIGHT_RANGE = 20.0f;
+    static constexpr float HEADLIGHT_RANGE = 30.0f;
+    static constexpr float BRAKE_LIGHT_RANGE = 10.0f;
     glm::mat4 treeModelMatrices_[N_TREES];
     glm::mat4 streetlightModelMatrices_[N_STREETLIGHTS];
     glm::vec3 streetlightLightPositions[N_STREETLIGHTS];
@@ -802,6 +933,12 @@ private:
     int currentScene_;
 
     bool isMouseMotionEnabled_;
+    float lodPixelError_;
+    bool isScreenSpaceOutline_;
+
+    // Statistiques du frustum culling de la dernière image.
+    unsigned int nVisibleObjects_;
+    unsigned int nCulledObjects_;
 };
 
 
@@ -0,0 +1,39 @@
+#include "material.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+MaterialTable::MaterialTable()
+: bindingIndex_(0), stride_(0)
+{
+
+}
+
+MaterialHandle MaterialTable::add(const Material& material)
+{
+    materials_.push_back(material);
+    return (MaterialHandle)(materials_.size() - 1);
+}
+
+void MaterialTable::upload(GLuint bindingIndex)
+{
+    // Les décalages de glBindBufferRange doivent respecter l'alignement du pilote,
+    // 256 octets couvre tout le matériel courant.
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment = std::max(alignment, 256);
+    stride_ = ((sizeof(Material) + alignment - 1) / alignment) * alignment;
+
+    std::vector<unsigned char> data(std::max<size_t>(materials_.size(), 1) * stride_, 0);
+    for (size_t i = 0; i < materials_.size(); i++)
+        memcpy(&data[i * stride_], &materials_[i], sizeof(Material));
+
+    buffer_.allocate(data.data(), (GLsizeiptr)data.size());
+    bindingIndex_ = bindingIndex;
+    use(0);
+}
+
+void MaterialTable::use(MaterialHandle handle)
+{
+    buffer_.bindRange(bindingIndex_, handle * stride_, sizeof(Material));
+}
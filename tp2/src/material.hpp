@@ -0,0 +1,46 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "uniform_buffer.hpp"
+
+using namespace gl;
+
+// Disposition std140 du bloc MaterialBlock des shaders.
+struct Material
+{
+    glm::vec4 emission; // vec3, but padded
+    glm::vec4 ambient;  // vec3, but padded
+    glm::vec4 diffuse;  // vec3, but padded
+    glm::vec3 specular;
+    GLfloat shininess;
+};
+
+typedef GLuint MaterialHandle;
+
+// Tous les matériaux de la scène, variantes allumées et éteintes comprises, dans un seul
+// UBO envoyé une fois. Changer de matériau se résume à un glBindBufferRange.
+class MaterialTable
+{
+public:
+    MaterialTable();
+
+    // Les matériaux sont ajoutés avant upload().
+    MaterialHandle add(const Material& material);
+
+    void upload(GLuint bindingIndex);
+
+    void use(MaterialHandle handle);
+
+private:
+    std::vector<Material> materials_;
+    UniformBuffer buffer_;
+    GLuint bindingIndex_;
+    GLsizeiptr stride_;
+};
+
+#endif // MATERIAL_H
@@ -0,0 +1,145 @@
+#include "mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x007FFFFF;
+
+    if (exponent <= 0)
+    {
+        // Sous-normal ou zéro en demi-précision.
+        if (exponent < -10)
+            return sign;
+        mantissa |= 0x00800000;
+        return sign | (uint16_t)((mantissa >> (14 - exponent)) + ((mantissa >> (13 - exponent)) & 1));
+    }
+    if (exponent >= 31)
+        return sign | 0x7BFF; // On sature au plus grand demi-flottant fini.
+
+    uint16_t half = sign | (uint16_t)(exponent << 10) | (uint16_t)(mantissa >> 13);
+    return half + (uint16_t)((mantissa >> 12) & 1); // Arrondi au plus proche.
+}
+
+static int16_t toSnorm16(float value)
+{
+    return (int16_t)std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+static void encodeOctahedral(const NormalAttribute& normal, int16_t out[2])
+{
+    glm::vec3 n(normal.x, normal.y, normal.z);
+    float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (l1 <= 0.0f)
+        n = glm::vec3(0.0f, 1.0f, 0.0f); // Même valeur par défaut que le shader pour les normales absentes.
+    else
+        n = n / l1;
+
+    float x = n.x;
+    float y = n.y;
+    if (n.z < 0.0f)
+    {
+        x = (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    out[0] = toSnorm16(x);
+    out[1] = toSnorm16(y);
+}
+
+MeshBounds computeMeshBounds(const VertexModel* vertices, size_t nVertices)
+{
+    MeshBounds bounds;
+    bounds.min = bounds.max = glm::vec3(0.0f);
+    if (nVertices > 0)
+    {
+        bounds.min = bounds.max = glm::vec3(vertices[0].pos.x, vertices[0].pos.y, vertices[0].pos.z);
+        for (size_t i = 1; i < nVertices; i++)
+        {
+            glm::vec3 p(vertices[i].pos.x, vertices[i].pos.y, vertices[i].pos.z);
+            bounds.min = glm::min(bounds.min, p);
+            bounds.max = glm::max(bounds.max, p);
+        }
+    }
+
+    // Sphère centrée sur la boîte, plus serrée que sa demi-diagonale.
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    float radius2 = 0.0f;
+    for (size_t i = 0; i < nVertices; i++)
+    {
+        glm::vec3 d = glm::vec3(vertices[i].pos.x, vertices[i].pos.y, vertices[i].pos.z) - bounds.center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    bounds.radius = std::sqrt(radius2);
+    return bounds;
+}
+
+static void compactIndices(const unsigned int* indices, size_t nIndices, size_t nVertices,
+                           std::vector<uint16_t>& indices16, std::vector<unsigned int>& indices32)
+{
+    if (nVertices < 0x10000)
+    {
+        indices16.resize(nIndices);
+        for (size_t i = 0; i < nIndices; i++)
+            indices16[i] = (uint16_t)indices[i];
+    }
+    else
+    {
+        indices32.assign(indices, indices + nIndices);
+    }
+}
+
+CompactMeshData compactMesh(const VertexModel* vertices, size_t nVertices, const unsigned int* indices, size_t nIndices,
+                            const MeshLodData* lods, size_t nLods)
+{
+    CompactMeshData compact;
+    compact.bounds = computeMeshBounds(vertices, nVertices);
+
+    glm::vec3 minPos = compact.bounds.min;
+    glm::vec3 extent = compact.bounds.max - compact.bounds.min;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (extent[axis] <= 0.0f)
+            extent[axis] = 1.0f;
+    }
+    compact.positionScale = extent;
+    compact.positionOffset = minPos;
+
+    compact.vertices.resize(nVertices);
+    for (size_t i = 0; i < nVertices; i++)
+    {
+        const VertexModel& v = vertices[i];
+        CompactVertexModel& c = compact.vertices[i];
+
+        glm::vec3 p = (glm::vec3(v.pos.x, v.pos.y, v.pos.z) - minPos) / extent;
+        for (int axis = 0; axis < 3; axis++)
+            c.pos[axis] = (uint16_t)std::lround(std::clamp(p[axis], 0.0f, 1.0f) * 65535.0f);
+        c.pos[3] = 0;
+
+        encodeOctahedral(v.normal, c.normal);
+
+        c.texCoord[0] = floatToHalf(v.texCoord.s);
+        c.texCoord[1] = floatToHalf(v.texCoord.t);
+
+        c.color[0] = v.color.r;
+        c.color[1] = v.color.g;
+        c.color[2] = v.color.b;
+        c.color[3] = 255;
+    }
+
+    compactIndices(indices, nIndices, nVertices, compact.indices16, compact.indices);
+
+    compact.lods.resize(nLods);
+    for (size_t i = 0; i < nLods; i++)
+    {
+        compactIndices(lods[i].indices.data(), lods[i].indices.size(), nVertices, compact.lods[i].indices16, compact.lods[i].indices);
+        compact.lods[i].error = lods[i].error;
+    }
+    return compact;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Format de vertex commun à tous les modèles chargés à partir de fichiers.
+
+struct PositionAttribute
+{
+    float x, y, z;
+};
+
+struct ColorUCharAttribute
+{
+    unsigned char r, g, b;
+};
+
+struct NormalAttribute
+{
+    float x, y, z;
+};
+
+struct TexCoordAttribute
+{
+    float s, t;
+};
+
+struct VertexModel
+{
+    PositionAttribute pos;
+    ColorUCharAttribute color;
+    NormalAttribute normal;
+    TexCoordAttribute texCoord;
+};
+
+// Attributs présents dans le fichier source, les autres sont laissés à zéro.
+enum MeshAttributeFlags : unsigned int
+{
+    MESH_HAS_COLOR     = 1 << 0,
+    MESH_HAS_NORMAL    = 1 << 1,
+    MESH_HAS_TEXCOORDS = 1 << 2,
+    MESH_IS_OPTIMIZED  = 1 << 3, // Ordre des triangles et des vertex déjà optimisé (optimizeMesh).
+    MESH_HAS_LODS      = 1 << 4, // Niveaux de détail déjà générés (generateMeshLods).
+};
+
+// Niveau de détail: une liste d'indices plus courte sur les mêmes vertex que le maillage.
+// L'erreur est la distance géométrique maximale introduite, dans l'espace du modèle.
+struct MeshLodData
+{
+    std::vector<unsigned int> indices;
+    float error;
+};
+
+// Maillage côté CPU, prêt à être envoyé dans les buffers OpenGL.
+struct MeshData
+{
+    std::vector<VertexModel> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<MeshLodData> lods; // Du plus détaillé au moins détaillé, sans le maillage complet.
+    unsigned int attributes = 0;
+};
+
+// Format de vertex compact (20 octets au lieu de 36): position quantifiée sur 16 bits
+// dans la boîte englobante du maillage, normale en encodage octaédrique, coordonnées
+// de texture en demi-flottants et couleur RGBA8.
+struct CompactVertexModel
+{
+    uint16_t pos[4];      // unorm16, w inutilisé (alignement)
+    int16_t normal[2];    // snorm16, octaédrique
+    uint16_t texCoord[2]; // half float
+    uint8_t color[4];     // unorm8
+};
+
+// Volumes englobants dans l'espace du modèle.
+struct MeshBounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec3 center; // Sphère englobante.
+    float radius;
+};
+
+MeshBounds computeMeshBounds(const VertexModel* vertices, size_t nVertices);
+
+struct CompactMeshLod
+{
+    std::vector<uint16_t> indices16;
+    std::vector<unsigned int> indices;
+    float error;
+};
+
+// Maillage converti au format compact. Les indices sont sur 16 bits quand le maillage
+// a moins de 65536 vertex, sinon on garde ceux du maillage source.
+struct CompactMeshData
+{
+    std::vector<CompactVertexModel> vertices;
+    std::vector<uint16_t> indices16;
+    std::vector<unsigned int> indices; // Seulement si indices16 est vide.
+    std::vector<CompactMeshLod> lods;
+    MeshBounds bounds;
+    glm::vec3 positionScale;  // position = positionOffset + positionScale * pos
+    glm::vec3 positionOffset;
+};
+
+CompactMeshData compactMesh(const VertexModel* vertices, size_t nVertices, const unsigned int* indices, size_t nIndices,
+                            const MeshLodData* lods = nullptr, size_t nLods = 0);
@@ -0,0 +1,258 @@
+#include "mesh_cache.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+#ifdef _WIN32
+    #include <Windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+static const char MESH_CACHE_MAGIC[4] = { 'M', 'E', 'S', 'H' };
+static const uint32_t MESH_CACHE_VERSION = 3;
+
+//
+// MappedFile
+//
+
+MappedFile::MappedFile()
+#ifdef _WIN32
+: file_(INVALID_HANDLE_VALUE), mapping_(NULL)
+#else
+: fd_(-1)
+#endif
+, data_(nullptr), size_(0)
+{
+
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char* path)
+{
+    close();
+
+#ifdef _WIN32
+    file_ = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file_ == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file_, &fileSize) || fileSize.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+    size_ = (size_t)fileSize.QuadPart;
+
+    mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping_ == NULL)
+    {
+        close();
+        return false;
+    }
+
+    data_ = (const unsigned char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+#else
+    fd_ = ::open(path, O_RDONLY);
+    if (fd_ < 0)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(fd_, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        close();
+        return false;
+    }
+    size_ = (size_t)fileStat.st_size;
+
+    void* address = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    data_ = (address == MAP_FAILED) ? nullptr : (const unsigned char*)address;
+#endif
+
+    if (!data_)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (data_)
+        UnmapViewOfFile(data_);
+    if (mapping_ != NULL)
+        CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE)
+        CloseHandle(file_);
+    file_ = INVALID_HANDLE_VALUE;
+    mapping_ = NULL;
+#else
+    if (data_)
+        munmap((void*)data_, size_);
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+#endif
+    data_ = nullptr;
+    size_ = 0;
+}
+
+//
+// Cache de maillages
+//
+
+static bool getSourceStamp(const char* sourcePath, uint64_t& size, int64_t& time)
+{
+    std::error_code error;
+    size = std::filesystem::file_size(sourcePath, error);
+    if (error)
+        return false;
+    time = (int64_t)std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+    return !error;
+}
+
+std::string getMeshCachePath(const char* sourcePath)
+{
+    return std::string(sourcePath) + ".meshcache";
+}
+
+bool openCachedMesh(const char* sourcePath, MappedFile& file, CachedMeshView& view)
+{
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (!getSourceStamp(sourcePath, sourceSize, sourceTime))
+        return false;
+
+    std::string cachePath = getMeshCachePath(sourcePath);
+    if (!file.open(cachePath.c_str()))
+        return false;
+
+    if (file.size() < sizeof(MeshCacheHeader))
+    {
+        file.close();
+        return false;
+    }
+
+    MeshCacheHeader header;
+    memcpy(&header, file.data(), sizeof(MeshCacheHeader));
+
+    bool isValid = memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) == 0
+                && header.version == MESH_CACHE_VERSION
+                && header.vertexStride == sizeof(CompactVertexModel)
+                && (header.indexSize == sizeof(uint16_t) || header.indexSize == sizeof(uint32_t))
+                && header.sourceSize == sourceSize
+                && header.sourceTime == sourceTime;
+
+    size_t vertexBytes = header.vertexCount * sizeof(CompactVertexModel);
+    size_t indexBytes = header.indexCount * header.indexSize;
+    size_t lodTableBytes = header.lodCount * sizeof(MeshCacheLod);
+    size_t expectedSize = sizeof(MeshCacheHeader) + vertexBytes + indexBytes + lodTableBytes;
+    std::vector<MeshCacheLod> lods(isValid && file.size() >= expectedSize ? header.lodCount : 0);
+    if (!lods.empty())
+        memcpy(lods.data(), file.data() + sizeof(MeshCacheHeader) + vertexBytes + indexBytes, lodTableBytes);
+    for (const MeshCacheLod& lod : lods)
+        expectedSize += lod.indexCount * header.indexSize;
+
+    if (!isValid || file.size() != expectedSize)
+    {
+        std::cout << "Mesh cache \"" << cachePath << "\" is stale, reparsing source." << std::endl;
+        file.close();
+        return false;
+    }
+
+    const unsigned char* payload = file.data() + sizeof(MeshCacheHeader);
+    view.vertices = (const CompactVertexModel*)payload;
+    view.vertexCount = header.vertexCount;
+    view.indices = payload + vertexBytes;
+    view.indexCount = header.indexCount;
+    view.indexSize = header.indexSize;
+    view.bounds = header.bounds;
+    view.positionScale = header.positionScale;
+    view.positionOffset = header.positionOffset;
+    view.attributes = header.attributes;
+
+    const unsigned char* lodIndices = payload + vertexBytes + indexBytes + lodTableBytes;
+    view.lods.clear();
+    for (const MeshCacheLod& lod : lods)
+    {
+        view.lods.push_back({ lodIndices, (size_t)lod.indexCount, lod.error });
+        lodIndices += lod.indexCount * header.indexSize;
+    }
+    return true;
+}
+
+static void writeIndices(std::ofstream& out, const std::vector<uint16_t>& indices16, const std::vector<unsigned int>& indices)
+{
+    if (!indices16.empty())
+        out.write((const char*)indices16.data(), indices16.size() * sizeof(uint16_t));
+    else
+        out.write((const char*)indices.data(), indices.size() * sizeof(unsigned int));
+}
+
+bool writeCachedMesh(const char* sourcePath, const CompactMeshData& mesh, unsigned int attributes)
+{
+    // compactMesh() choisit la même taille d'indices pour le maillage et ses niveaux.
+    bool is16Bit = !mesh.indices16.empty();
+
+    MeshCacheHeader header = {};
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    header.version = MESH_CACHE_VERSION;
+    header.attributes = attributes;
+    header.vertexStride = sizeof(CompactVertexModel);
+    header.vertexCount = mesh.vertices.size();
+    header.indexCount = is16Bit ? mesh.indices16.size() : mesh.indices.size();
+    header.indexSize = is16Bit ? sizeof(uint16_t) : sizeof(uint32_t);
+    header.lodCount = (uint32_t)mesh.lods.size();
+    header.bounds = mesh.bounds;
+    header.positionScale = mesh.positionScale;
+    header.positionOffset = mesh.positionOffset;
+    if (!getSourceStamp(sourcePath, header.sourceSize, header.sourceTime))
+        return false;
+
+    // On écrit dans un fichier temporaire pour ne jamais laisser un cache à moitié écrit.
+    std::string cachePath = getMeshCachePath(sourcePath);
+    std::string tmpPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(CompactVertexModel));
+        writeIndices(out, mesh.indices16, mesh.indices);
+        for (const CompactMeshLod& lod : mesh.lods)
+        {
+            MeshCacheLod entry = {};
+            entry.indexCount = is16Bit ? lod.indices16.size() : lod.indices.size();
+            entry.error = lod.error;
+            out.write((const char*)&entry, sizeof(entry));
+        }
+        for (const CompactMeshLod& lod : mesh.lods)
+            writeIndices(out, lod.indices16, lod.indices);
+        if (!out)
+            return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tmpPath, cachePath, error);
+    if (error)
+    {
+        std::cout << "Could not write mesh cache \"" << cachePath << "\": " << error.message() << std::endl;
+        std::filesystem::remove(tmpPath, error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mesh.hpp"
+
+// Fichier en lecture seule projeté en mémoire.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char* path);
+    void close();
+
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+#ifdef _WIN32
+    void* file_;
+    void* mapping_;
+#else
+    int fd_;
+#endif
+    const unsigned char* data_;
+    size_t size_;
+};
+
+// Format binaire "cuit" d'un maillage, dans la disposition envoyée au GPU: un en-tête, les
+// CompactVertexModel, les indices (16 ou 32 bits), la table des niveaux de détail puis leurs
+// indices bout à bout, de la même taille que ceux du maillage complet.
+// Le cache est invalidé si la taille ou la date de modification du fichier source change.
+struct MeshCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint32_t attributes;
+    uint32_t vertexStride;
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint32_t indexSize; // 2 ou 4 octets.
+    uint32_t lodCount;
+    MeshBounds bounds;
+    glm::vec3 positionScale;
+    glm::vec3 positionOffset;
+};
+
+struct MeshCacheLod
+{
+    uint64_t indexCount;
+    float error;
+    uint32_t reserved;
+};
+
+struct CachedLodView
+{
+    const void* indices;
+    size_t indexCount;
+    float error;
+};
+
+// Vue sur un maillage cuit, les pointeurs restent valides tant que le MappedFile est ouvert.
+struct CachedMeshView
+{
+    const CompactVertexModel* vertices;
+    size_t vertexCount;
+    const void* indices;
+    size_t indexCount;
+    size_t indexSize;
+    std::vector<CachedLodView> lods;
+    MeshBounds bounds;
+    glm::vec3 positionScale;
+    glm::vec3 positionOffset;
+    unsigned int attributes;
+};
+
+std::string getMeshCachePath(const char* sourcePath);
+
+bool openCachedMesh(const char* sourcePath, MappedFile& file, CachedMeshView& view);
+// attributes: ceux du MeshData d'origine, avec MESH_IS_OPTIMIZED et MESH_HAS_LODS.
+bool writeCachedMesh(const char* sourcePath, const CompactMeshData& mesh, unsigned int attributes);
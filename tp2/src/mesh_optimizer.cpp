@@ -0,0 +1,270 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+#include <glm/glm.hpp>
+
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t nIndices, size_t nVertices, unsigned int cacheSize)
+{
+    // Cache FIFO, comme sur la plupart des GPU.
+    std::vector<size_t> cacheTime(nVertices, 0);
+    std::vector<bool> isUsed(nVertices, false);
+    size_t timestamp = cacheSize + 1;
+    size_t misses = 0;
+    size_t uniqueVertices = 0;
+
+    for (size_t i = 0; i < nIndices; i++)
+    {
+        unsigned int v = indices[i];
+        if (timestamp - cacheTime[v] > cacheSize)
+        {
+            cacheTime[v] = timestamp++;
+            misses++;
+        }
+        if (!isUsed[v])
+        {
+            isUsed[v] = true;
+            uniqueVertices++;
+        }
+    }
+
+    VertexCacheStats stats;
+    stats.acmr = nIndices > 0 ? (float)misses / (float)(nIndices / 3) : 0.0f;
+    stats.atvr = uniqueVertices > 0 ? (float)misses / (float)uniqueVertices : 0.0f;
+    return stats;
+}
+
+void optimizeVertexCache(unsigned int* destination, const unsigned int* indices, size_t nIndices, size_t nVertices,
+                         unsigned int cacheSize)
+{
+    size_t nTriangles = nIndices / 3;
+
+    // Adjacence vertex -> triangles, en format compact.
+    std::vector<unsigned int> live(nVertices, 0);
+    for (size_t i = 0; i < nIndices; i++)
+        live[indices[i]]++;
+
+    std::vector<size_t> adjacencyStart(nVertices + 1, 0);
+    for (size_t v = 0; v < nVertices; v++)
+        adjacencyStart[v + 1] = adjacencyStart[v] + live[v];
+
+    std::vector<unsigned int> adjacency(nIndices);
+    std::vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t i = 0; i < nIndices; i++)
+        adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+    std::vector<size_t> cacheTime(nVertices, 0);
+    std::vector<bool> isEmitted(nTriangles, false);
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    size_t timestamp = cacheSize + 1;
+    size_t cursor = 0;
+    size_t outputIndex = 0;
+
+    // Prochain vertex encore vivant: d'abord la pile des culs-de-sac, puis l'ordre d'entrée.
+    auto skipDeadEnd = [&]() -> long long
+    {
+        while (!deadEnd.empty())
+        {
+            unsigned int d = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[d] > 0)
+                return d;
+        }
+        while (cursor < nVertices)
+        {
+            if (live[cursor] > 0)
+                return (long long)cursor;
+            cursor++;
+        }
+        return -1;
+    };
+
+    long long fanning = skipDeadEnd();
+    while (fanning >= 0)
+    {
+        // On avance tant que le prochain vertex peut être choisi parmi les candidats.
+        while (fanning >= 0)
+        {
+            candidates.clear();
+            for (size_t a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; a++)
+            {
+                unsigned int t = adjacency[a];
+                if (isEmitted[t])
+                    continue;
+
+                for (int k = 0; k < 3; k++)
+                {
+                    unsigned int v = indices[t * 3 + k];
+                    destination[outputIndex++] = v;
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+                    if (timestamp - cacheTime[v] > cacheSize)
+                        cacheTime[v] = timestamp++;
+                }
+                isEmitted[t] = true;
+            }
+
+            // Le candidat le plus ancien dont tous les triangles restants tiennent encore dans le cache.
+            long long best = -1;
+            long long bestPriority = -1;
+            for (unsigned int v : candidates)
+            {
+                if (live[v] == 0)
+                    continue;
+
+                long long priority = 0;
+                if (timestamp - cacheTime[v] + 2 * live[v] <= cacheSize)
+                    priority = (long long)(timestamp - cacheTime[v]);
+                if (priority > bestPriority)
+                {
+                    best = v;
+                    bestPriority = priority;
+                }
+            }
+            fanning = best;
+        }
+
+        fanning = skipDeadEnd();
+    }
+}
+
+// Débuts des groupes: triangles dont les trois vertex manquent le cache FIFO simulé.
+static std::vector<size_t> findHardBoundaries(const unsigned int* indices, size_t nIndices, size_t nVertices, unsigned int cacheSize)
+{
+    std::vector<size_t> cacheTime(nVertices, 0);
+    size_t timestamp = cacheSize + 1;
+    std::vector<size_t> clusters;
+
+    for (size_t t = 0; t < nIndices / 3; t++)
+    {
+        int misses = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = indices[t * 3 + k];
+            if (timestamp - cacheTime[v] > cacheSize)
+            {
+                cacheTime[v] = timestamp++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3)
+            clusters.push_back(t);
+    }
+    return clusters;
+}
+
+void optimizeOverdraw(unsigned int* indices, size_t nIndices, const VertexModel* vertices, size_t nVertices,
+                      float threshold, unsigned int cacheSize)
+{
+    size_t nTriangles = nIndices / 3;
+    std::vector<size_t> clusters = findHardBoundaries(indices, nIndices, nVertices, cacheSize);
+    size_t nClusters = clusters.size();
+    if (nClusters <= 1)
+        return;
+
+    auto getPosition = [&](unsigned int v)
+    {
+        return glm::vec3(vertices[v].pos.x, vertices[v].pos.y, vertices[v].pos.z);
+    };
+
+    // Centroïde du maillage pondéré par l'aire des triangles.
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t t = 0; t < nTriangles; t++)
+    {
+        glm::vec3 a = getPosition(indices[t * 3]), b = getPosition(indices[t * 3 + 1]), c = getPosition(indices[t * 3 + 2]);
+        float area = glm::length(glm::cross(b - a, c - a));
+        meshCentroid += (a + b + c) * (area / 3.0f);
+        meshArea += area;
+    }
+    meshCentroid /= std::max(meshArea, 1e-20f);
+
+    // Potentiel d'occultation: un groupe loin du centre et tourné vers l'extérieur cache
+    // probablement le reste, on le dessine en premier.
+    std::vector<float> potential(nClusters);
+    for (size_t i = 0; i < nClusters; i++)
+    {
+        size_t begin = clusters[i];
+        size_t end = i + 1 < nClusters ? clusters[i + 1] : nTriangles;
+
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float clusterArea = 0.0f;
+        for (size_t t = begin; t < end; t++)
+        {
+            glm::vec3 a = getPosition(indices[t * 3]), b = getPosition(indices[t * 3 + 1]), c = getPosition(indices[t * 3 + 2]);
+            glm::vec3 n = glm::cross(b - a, c - a);
+            float area = glm::length(n);
+            centroid += (a + b + c) * (area / 3.0f);
+            normal += n;
+            clusterArea += area;
+        }
+        centroid /= std::max(clusterArea, 1e-20f);
+        float normalLength = glm::length(normal);
+        if (normalLength > 0.0f)
+            normal /= normalLength;
+
+        potential[i] = glm::dot(centroid - meshCentroid, normal);
+    }
+
+    std::vector<size_t> order(nClusters);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return potential[a] > potential[b]; });
+
+    std::vector<unsigned int> sorted;
+    sorted.reserve(nIndices);
+    for (size_t i : order)
+    {
+        size_t begin = clusters[i];
+        size_t end = i + 1 < nClusters ? clusters[i + 1] : nTriangles;
+        sorted.insert(sorted.end(), indices + begin * 3, indices + end * 3);
+    }
+
+    float acmr = analyzeVertexCache(indices, nIndices, nVertices, cacheSize).acmr;
+    float sortedAcmr = analyzeVertexCache(sorted.data(), nIndices, nVertices, cacheSize).acmr;
+    if (sortedAcmr <= acmr * threshold)
+        std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+void optimizeVertexFetch(MeshData& mesh)
+{
+    const unsigned int UNUSED = ~0u;
+    std::vector<unsigned int> remap(mesh.vertices.size(), UNUSED);
+    std::vector<VertexModel> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    for (unsigned int& index : mesh.indices)
+    {
+        if (remap[index] == UNUSED)
+        {
+            remap[index] = (unsigned int)vertices.size();
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+void optimizeMesh(MeshData& mesh, VertexCacheStats* before, VertexCacheStats* after)
+{
+    size_t nVertices = mesh.vertices.size();
+    size_t nIndices = mesh.indices.size() - mesh.indices.size() % 3;
+    mesh.indices.resize(nIndices);
+
+    if (before)
+        *before = analyzeVertexCache(mesh.indices.data(), nIndices, nVertices);
+
+    std::vector<unsigned int> optimized(nIndices);
+    optimizeVertexCache(optimized.data(), mesh.indices.data(), nIndices, nVertices);
+    optimizeOverdraw(optimized.data(), nIndices, mesh.vertices.data(), nVertices);
+    mesh.indices.swap(optimized);
+
+    optimizeVertexFetch(mesh);
+    mesh.attributes |= MESH_IS_OPTIMIZED;
+
+    if (after)
+        *after = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+#include "mesh.hpp"
+
+// Taille du cache post-transformation simulé, typique du matériel actuel.
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+// Efficacité du cache post-transformation pour un ordre de triangles donné.
+// ACMR: vertex transformés par triangle (entre 0.5 et 3, plus bas est mieux).
+// ATVR: vertex transformés par vertex unique (1 est optimal).
+struct VertexCacheStats
+{
+    float acmr;
+    float atvr;
+};
+
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t nIndices, size_t nVertices, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Tipsify (Sander et al. 2007): réordonne les triangles pour le cache post-transformation.
+void optimizeVertexCache(unsigned int* destination, const unsigned int* indices, size_t nIndices, size_t nVertices,
+                         unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Découpe l'ordre de optimizeVertexCache en groupes là où le cache est entièrement perdu,
+// puis trie les groupes du plus occultant au moins occultant pour réduire le surdessin.
+// L'ordre n'est gardé que si l'ACMR ne dépasse pas threshold fois celui d'entrée.
+void optimizeOverdraw(unsigned int* indices, size_t nIndices, const VertexModel* vertices, size_t nVertices,
+                      float threshold = 1.05f, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Renumérote les vertex dans l'ordre de leur première utilisation, les vertex non référencés sont retirés.
+void optimizeVertexFetch(MeshData& mesh);
+
+// Les trois passes dans l'ordre, le maillage est marqué MESH_IS_OPTIMIZED.
+void optimizeMesh(MeshData& mesh, VertexCacheStats* before = nullptr, VertexCacheStats* after = nullptr);
@@ -0,0 +1,289 @@
+#include "mesh_pool.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "gl_state.hpp"
+
+const GLuint VERTEX_POSITION_INDEX = 0;
+const GLuint VERTEX_COLOR_INDEX = 1;
+const GLuint VERTEX_NORMAL_INDEX = 2;
+const GLuint VERTEX_TEXCOORDS_INDEX = 3;
+const GLuint VERTEX_INSTANCE_MODEL_INDEX = 4; // mat4, occupe les index 4 à 7.
+const GLuint VERTEX_OCT_NORMAL_INDEX = 8;
+const GLuint VERTEX_POSITION_SCALE_INDEX = 9;  // Attribut constant, w = 1 pour le format compact.
+const GLuint VERTEX_POSITION_OFFSET_INDEX = 10; // Attribut constant.
+
+const size_t INITIAL_VERTEX_CAPACITY = 1 << 16;
+const size_t INITIAL_INDEX_CAPACITY_BYTES = (3 << 16) * sizeof(unsigned int);
+const size_t INITIAL_INSTANCE_CAPACITY = 1 << 10;
+
+// Remplace un buffer par un plus grand en conservant son contenu.
+static void growBuffer(GLuint& id, size_t usedBytes, size_t newBytes)
+{
+    GLuint newId;
+    glGenBuffers(1, &newId);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newId);
+    glBufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+
+    if (usedBytes > 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, id);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+    }
+
+    glDeleteBuffers(1, &id);
+    id = newId;
+}
+
+static size_t getIndexSize(GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+MeshPool& MeshPool::get(VertexFormat format)
+{
+    static MeshPool fullPool(VertexFormat::Full);
+    static MeshPool compactPool(VertexFormat::Compact);
+    return format == VertexFormat::Compact ? compactPool : fullPool;
+}
+
+void MeshPool::releaseAll()
+{
+    get(VertexFormat::Full).release();
+    get(VertexFormat::Compact).release();
+}
+
+MeshPool::MeshPool(VertexFormat format)
+: format_(format)
+, vertexStride_(format == VertexFormat::Compact ? sizeof(CompactVertexModel) : sizeof(VertexModel))
+, vao_(0), vbo_(0), ebo_(0), instanceVbo_(0)
+, vertexCapacity_(0), vertexCount_(0)
+, indexCapacityBytes_(0), indexBytes_(0)
+, instanceCapacity_(0), instanceCount_(0)
+, currentBaseInstance_(0)
+{
+
+}
+
+MeshPool::~MeshPool()
+{
+    release();
+}
+
+void MeshPool::release()
+{
+    glDeleteBuffers(1, &instanceVbo_);
+    glDeleteBuffers(1, &ebo_);
+    glDeleteBuffers(1, &vbo_);
+    if (vao_)
+        GLStateCache::get().bindVertexArray(0);
+    glDeleteVertexArrays(1, &vao_);
+    vao_ = vbo_ = ebo_ = instanceVbo_ = 0;
+    vertexCapacity_ = vertexCount_ = 0;
+    indexCapacityBytes_ = indexBytes_ = 0;
+    instanceCapacity_ = instanceCount_ = 0;
+}
+
+void MeshPool::create()
+{
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &vbo_);
+    glGenBuffers(1, &ebo_);
+    glGenBuffers(1, &instanceVbo_);
+
+    reserveVertices(INITIAL_VERTEX_CAPACITY);
+    reserveIndexBytes(INITIAL_INDEX_CAPACITY_BYTES);
+    reserveInstances(INITIAL_INSTANCE_CAPACITY);
+
+    GLStateCache::get().bindVertexArray(vao_);
+    for (GLuint i = 0; i < 4; i++)
+    {
+        glEnableVertexAttribArray(VERTEX_INSTANCE_MODEL_INDEX + i);
+        glVertexAttribDivisor(VERTEX_INSTANCE_MODEL_INDEX + i, 1);
+    }
+    GLStateCache::get().bindVertexArray(0);
+}
+
+void MeshPool::setupVertexAttributes()
+{
+    GLStateCache::get().bindVertexArray(vao_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+
+    // Les attributs sont toujours actifs: les attributs absents du fichier source sont à zéro.
+    if (format_ == VertexFormat::Compact)
+    {
+        glEnableVertexAttribArray(VERTEX_POSITION_INDEX);
+        glVertexAttribPointer(VERTEX_POSITION_INDEX, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertexModel), (GLvoid*)(offsetof(CompactVertexModel, pos)));
+
+        glEnableVertexAttribArray(VERTEX_COLOR_INDEX);
+        glVertexAttribPointer(VERTEX_COLOR_INDEX, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CompactVertexModel), (GLvoid*)(offsetof(CompactVertexModel, color)));
+
+        glDisableVertexAttribArray(VERTEX_NORMAL_INDEX);
+        glEnableVertexAttribArray(VERTEX_OCT_NORMAL_INDEX);
+        glVertexAttribPointer(VERTEX_OCT_NORMAL_INDEX, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertexModel), (GLvoid*)(offsetof(CompactVertexModel, normal)));
+
+        glEnableVertexAttribArray(VERTEX_TEXCOORDS_INDEX);
+        glVertexAttribPointer(VERTEX_TEXCOORDS_INDEX, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertexModel), (GLvoid*)(offsetof(CompactVertexModel, texCoord)));
+    }
+    else
+    {
+        glEnableVertexAttribArray(VERTEX_POSITION_INDEX);
+        glVertexAttribPointer(VERTEX_POSITION_INDEX, 3, GL_FLOAT, GL_FALSE, sizeof(VertexModel), (GLvoid*)(offsetof(VertexModel, pos)));
+
+        glEnableVertexAttribArray(VERTEX_COLOR_INDEX);
+        glVertexAttribPointer(VERTEX_COLOR_INDEX, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexModel), (GLvoid*)(offsetof(VertexModel, color)));
+
+        glEnableVertexAttribArray(VERTEX_NORMAL_INDEX);
+        glVertexAttribPointer(VERTEX_NORMAL_INDEX, 3, GL_FLOAT, GL_FALSE, sizeof(VertexModel), (GLvoid*)(offsetof(VertexModel, normal)));
+        glDisableVertexAttribArray(VERTEX_OCT_NORMAL_INDEX);
+
+        glEnableVertexAttribArray(VERTEX_TEXCOORDS_INDEX);
+        glVertexAttribPointer(VERTEX_TEXCOORDS_INDEX, 2, GL_FLOAT, GL_FALSE, sizeof(VertexModel), (GLvoid*)(offsetof(VertexModel, texCoord)));
+    }
+
+    GLStateCache::get().bindVertexArray(0);
+}
+
+void MeshPool::reserveVertices(size_t nVertices)
+{
+    if (nVertices <= vertexCapacity_)
+        return;
+
+    size_t newCapacity = std::max(nVertices, 2 * vertexCapacity_);
+    growBuffer(vbo_, vertexCount_ * vertexStride_, newCapacity * vertexStride_);
+    vertexCapacity_ = newCapacity;
+
+    setupVertexAttributes();
+}
+
+void MeshPool::reserveIndexBytes(size_t nBytes)
+{
+    if (nBytes <= indexCapacityBytes_)
+        return;
+
+    size_t newCapacity = std::max(nBytes, 2 * indexCapacityBytes_);
+    growBuffer(ebo_, indexBytes_, newCapacity);
+    indexCapacityBytes_ = newCapacity;
+
+    GLStateCache::get().bindVertexArray(vao_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+    GLStateCache::get().bindVertexArray(0);
+}
+
+void MeshPool::reserveInstances(size_t nInstances)
+{
+    if (nInstances <= instanceCapacity_)
+        return;
+
+    size_t newCapacity = std::max(nInstances, 2 * instanceCapacity_);
+    growBuffer(instanceVbo_, instanceCount_ * sizeof(glm::mat4), newCapacity * sizeof(glm::mat4));
+    instanceCapacity_ = newCapacity;
+
+    GLStateCache::get().bindVertexArray(vao_);
+    setupInstanceAttributes(currentBaseInstance_);
+    GLStateCache::get().bindVertexArray(0);
+}
+
+void MeshPool::setupInstanceAttributes(GLuint baseInstance)
+{
+    // Sans glDrawElementsInstancedBaseVertexBaseInstance (GL 4.2), on déplace plutôt
+    // le début des attributs d'instance dans le buffer partagé.
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVbo_);
+    size_t offset = baseInstance * sizeof(glm::mat4);
+    for (GLuint i = 0; i < 4; i++)
+    {
+        glVertexAttribPointer(VERTEX_INSTANCE_MODEL_INDEX + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (GLvoid*)(offset + i * sizeof(glm::vec4)));
+    }
+    currentBaseInstance_ = baseInstance;
+}
+
+MeshRange MeshPool::allocate(const void* vertices, size_t nVertices, const void* indices, size_t nIndices, GLenum indexType)
+{
+    if (!vao_)
+        create();
+
+    reserveVertices(vertexCount_ + nVertices);
+
+    MeshRange range;
+    range.baseVertex = (GLint)vertexCount_;
+    range.indexOffset = 0;
+    range.count = 0;
+    range.indexType = indexType;
+    range.positionScale = glm::vec3(1.0f);
+    range.positionOffset = glm::vec3(0.0f);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbo_);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertexCount_ * vertexStride_, nVertices * vertexStride_, vertices);
+    vertexCount_ += nVertices;
+
+    return allocateIndices(range, indices, nIndices);
+}
+
+MeshRange MeshPool::allocateIndices(const MeshRange& mesh, const void* indices, size_t nIndices)
+{
+    // Les indices 16 et 32 bits cohabitent dans le même buffer, chaque bloc est aligné sur 4 octets.
+    size_t indexOffset = (indexBytes_ + 3) & ~size_t(3);
+    size_t indexBlockBytes = nIndices * getIndexSize(mesh.indexType);
+    reserveIndexBytes(indexOffset + indexBlockBytes);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ebo_);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexBlockBytes, indices);
+    indexBytes_ = indexOffset + indexBlockBytes;
+
+    MeshRange range = mesh;
+    range.indexOffset = indexOffset;
+    range.count = (GLsizei)nIndices;
+    return range;
+}
+
+InstanceRange MeshPool::allocateInstances(GLsizei count)
+{
+    if (!vao_)
+        create();
+
+    reserveInstances(instanceCount_ + count);
+
+    InstanceRange range;
+    range.baseInstance = (GLuint)instanceCount_;
+    range.capacity = count;
+    instanceCount_ += count;
+    return range;
+}
+
+void MeshPool::updateInstances(const InstanceRange& range, const glm::mat4* matrices, GLsizei count)
+{
+    glBindBuffer(GL_COPY_WRITE_BUFFER, instanceVbo_);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, range.baseInstance * sizeof(glm::mat4), std::min(count, range.capacity) * sizeof(glm::mat4), matrices);
+}
+
+void MeshPool::bind()
+{
+    GLStateCache::get().bindVertexArray(vao_);
+}
+
+void MeshPool::setQuantization(const MeshRange& range)
+{
+    // Attributs constants: valeurs courantes du contexte, donc valides pour tous les programmes.
+    // Le même maillage dessiné deux fois de suite (contour) ne les renvoie pas.
+    float isCompact = format_ == VertexFormat::Compact ? 1.0f : 0.0f;
+    GLStateCache& state = GLStateCache::get();
+    state.setVertexAttrib(VERTEX_POSITION_SCALE_INDEX, glm::vec4(range.positionScale, isCompact));
+    state.setVertexAttrib(VERTEX_POSITION_OFFSET_INDEX, glm::vec4(range.positionOffset, 1.0f));
+}
+
+void MeshPool::draw(const MeshRange& range)
+{
+    bind();
+    setQuantization(range);
+    glDrawElementsBaseVertex(GL_TRIANGLES, range.count, range.indexType, (GLvoid*)range.indexOffset, range.baseVertex);
+}
+
+void MeshPool::drawInstanced(const MeshRange& range, const InstanceRange& instances, GLsizei count)
+{
+    bind();
+    setQuantization(range);
+    if (instances.baseInstance != currentBaseInstance_)
+        setupInstanceAttributes(instances.baseInstance);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.count, range.indexType, (GLvoid*)range.indexOffset, std::min(count, instances.capacity), range.baseVertex);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "mesh.hpp"
+
+using namespace gl;
+
+enum class VertexFormat
+{
+    Full,    // VertexModel
+    Compact, // CompactVertexModel
+};
+
+// Emplacement d'un maillage dans le MeshPool.
+struct MeshRange
+{
+    GLint baseVertex;
+    size_t indexOffset; // En octets dans le buffer d'indices.
+    GLsizei count;
+    GLenum indexType;
+
+    // Déquantification des positions, fournie aux shaders par des attributs constants.
+    glm::vec3 positionScale;
+    glm::vec3 positionOffset;
+};
+
+// Emplacement d'un bloc de matrices d'instance dans le MeshPool.
+struct InstanceRange
+{
+    GLuint baseInstance;
+    GLsizei capacity;
+};
+
+// Arène de géométrie statique: tous les maillages d'un même format de vertex partagent
+// un seul VBO, un seul EBO et un seul VAO. Chaque modèle n'est plus qu'un décalage et
+// un nombre d'indices dessiné avec glDrawElementsBaseVertex.
+class MeshPool
+{
+public:
+    static MeshPool& get(VertexFormat format = VertexFormat::Full);
+
+    ~MeshPool();
+
+    MeshPool(const MeshPool&) = delete;
+    MeshPool& operator=(const MeshPool&) = delete;
+
+    MeshRange allocate(const void* vertices, size_t nVertices, const void* indices, size_t nIndices, GLenum indexType);
+    // Nouvelle liste d'indices sur les vertex d'un maillage déjà alloué (niveaux de détail).
+    MeshRange allocateIndices(const MeshRange& mesh, const void* indices, size_t nIndices);
+
+    InstanceRange allocateInstances(GLsizei count);
+    void updateInstances(const InstanceRange& range, const glm::mat4* matrices, GLsizei count);
+
+    void bind();
+    void draw(const MeshRange& range);
+    void drawInstanced(const MeshRange& range, const InstanceRange& instances, GLsizei count);
+
+    void release();
+
+    static void releaseAll();
+
+private:
+    explicit MeshPool(VertexFormat format);
+
+    void create();
+    void setupVertexAttributes();
+    void reserveVertices(size_t nVertices);
+    void reserveIndexBytes(size_t nBytes);
+    void reserveInstances(size_t nInstances);
+    void setupInstanceAttributes(GLuint baseInstance);
+    void setQuantization(const MeshRange& range);
+
+private:
+    VertexFormat format_;
+    size_t vertexStride_;
+
+    GLuint vao_, vbo_, ebo_, instanceVbo_;
+
+    size_t vertexCapacity_, vertexCount_;
+    size_t indexCapacityBytes_, indexBytes_;
+    size_t instanceCapacity_, instanceCount_;
+
+    GLuint currentBaseInstance_; // Décalage actuel des attributs d'instance dans le VAO.
+};
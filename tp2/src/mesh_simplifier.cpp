@@ -0,0 +1,396 @@
+#include "mesh_simplifier.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "mesh_optimizer.hpp"
+
+// Quadrique symétrique 4x4: somme des carrés des distances à des plans pondérés.
+struct Quadric
+{
+    double a2, b2, c2, d2, ab, ac, ad, bc, bd, cd;
+    double w;
+
+    void addPlane(const glm::vec3& n, float d, float weight)
+    {
+        w += weight;
+        a2 += weight * n.x * n.x; b2 += weight * n.y * n.y; c2 += weight * n.z * n.z; d2 += weight * d * d;
+        ab += weight * n.x * n.y; ac += weight * n.x * n.z; ad += weight * n.x * d;
+        bc += weight * n.y * n.z; bd += weight * n.y * d; cd += weight * n.z * d;
+    }
+
+    void add(const Quadric& q)
+    {
+        a2 += q.a2; b2 += q.b2; c2 += q.c2; d2 += q.d2;
+        ab += q.ab; ac += q.ac; ad += q.ad; bc += q.bc; bd += q.bd; cd += q.cd;
+        w += q.w;
+    }
+
+    // Carré de la distance moyenne aux plans.
+    double evaluate(const glm::vec3& p) const
+    {
+        if (w <= 0.0)
+            return 0.0;
+
+        double x = p.x, y = p.y, z = p.z;
+        double r = a2 * x * x + b2 * y * y + c2 * z * z + d2
+                 + 2.0 * (ab * x * y + ac * x * z + ad * x + bc * y * z + bd * y + cd * z);
+        return std::max(r, 0.0) / w;
+    }
+};
+
+enum VertexKind : unsigned char
+{
+    VERTEX_MANIFOLD, // Intérieur d'une surface, peut aller n'importe où.
+    VERTEX_BORDER,   // Sur un bord ouvert, ne peut glisser que le long de ce bord.
+    VERTEX_LOCKED,   // Arête non-manifold, jamais déplacé.
+};
+
+// Les arêtes sont identifiées par leurs deux positions soudées, la plus petite en premier.
+static uint64_t getEdgeKey(unsigned int a, unsigned int b)
+{
+    return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+struct PositionHash
+{
+    size_t operator()(const PositionAttribute& p) const
+    {
+        uint32_t h[3];
+        memcpy(h, &p, sizeof(h));
+        return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+    }
+};
+
+struct PositionEqual
+{
+    bool operator()(const PositionAttribute& a, const PositionAttribute& b) const
+    {
+        return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+};
+
+static glm::vec3 toVec3(const PositionAttribute& p)
+{
+    return glm::vec3(p.x, p.y, p.z);
+}
+
+float simplifyMesh(std::vector<unsigned int>& destination, const VertexModel* vertices, size_t nVertices,
+                   const unsigned int* indices, size_t nIndices, size_t targetIndexCount, float targetError)
+{
+    destination.assign(indices, indices + nIndices - nIndices % 3);
+
+    // Les vertex qui ne diffèrent que par la normale ou les coordonnées de texture
+    // (arêtes vives, coutures) sont soudés: la simplification travaille sur les positions.
+    std::unordered_map<PositionAttribute, unsigned int, PositionHash, PositionEqual> positionIds;
+    std::vector<unsigned int> positionOf(nVertices);
+    std::vector<glm::vec3> positions;
+    for (size_t v = 0; v < nVertices; v++)
+    {
+        auto inserted = positionIds.emplace(vertices[v].pos, (unsigned int)positions.size());
+        if (inserted.second)
+            positions.push_back(toVec3(vertices[v].pos));
+        positionOf[v] = inserted.first->second;
+    }
+    size_t nPositions = positions.size();
+
+    // Positions normalisées dans la boîte englobante pour que l'erreur soit relative.
+    glm::vec3 minPos = positions.empty() ? glm::vec3(0.0f) : positions[0];
+    glm::vec3 maxPos = minPos;
+    for (const glm::vec3& p : positions)
+    {
+        minPos = glm::min(minPos, p);
+        maxPos = glm::max(maxPos, p);
+    }
+    glm::vec3 extent = maxPos - minPos;
+    float scale = std::max(std::max(extent.x, extent.y), extent.z);
+    scale = scale > 0.0f ? 1.0f / scale : 1.0f;
+    for (glm::vec3& p : positions)
+        p = (p - minPos) * scale;
+
+    // Vertex partageant chaque position, pour choisir un remplaçant lors d'une contraction.
+    std::vector<size_t> wedgeStart(nPositions + 1, 0);
+    for (size_t v = 0; v < nVertices; v++)
+        wedgeStart[positionOf[v] + 1]++;
+    for (size_t p = 0; p < nPositions; p++)
+        wedgeStart[p + 1] += wedgeStart[p];
+    std::vector<unsigned int> wedges(nVertices);
+    {
+        std::vector<size_t> fill(wedgeStart.begin(), wedgeStart.end() - 1);
+        for (size_t v = 0; v < nVertices; v++)
+            wedges[fill[positionOf[v]]++] = (unsigned int)v;
+    }
+
+    // Classification des positions selon le nombre de triangles autour de chaque arête.
+    std::unordered_map<uint64_t, unsigned int> edgeUse;
+    for (size_t i = 0; i < destination.size(); i += 3)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int a = positionOf[destination[i + k]];
+            unsigned int b = positionOf[destination[i + (k + 1) % 3]];
+            if (a != b)
+                edgeUse[getEdgeKey(a, b)]++;
+        }
+    }
+
+    std::vector<VertexKind> kinds(nPositions, VERTEX_MANIFOLD);
+    std::vector<Quadric> quadrics(nPositions, Quadric{});
+    for (size_t i = 0; i < destination.size(); i += 3)
+    {
+        unsigned int p[3] = { positionOf[destination[i]], positionOf[destination[i + 1]], positionOf[destination[i + 2]] };
+        glm::vec3 normal = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+        float area = glm::length(normal);
+        if (area <= 0.0f)
+            continue;
+        normal /= area;
+
+        Quadric face = {};
+        face.addPlane(normal, -glm::dot(normal, positions[p[0]]), area);
+        for (int k = 0; k < 3; k++)
+            quadrics[p[k]].add(face);
+
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int a = p[k];
+            unsigned int b = p[(k + 1) % 3];
+            unsigned int use = edgeUse[getEdgeKey(a, b)];
+            if (use == 1)
+            {
+                // Plan perpendiculaire au bord: le bord garde sa forme, donc la silhouette aussi.
+                glm::vec3 edge = positions[b] - positions[a];
+                float length = glm::length(edge);
+                if (length > 0.0f)
+                {
+                    glm::vec3 borderNormal = glm::normalize(glm::cross(edge, normal));
+                    Quadric border = {};
+                    border.addPlane(borderNormal, -glm::dot(borderNormal, positions[a]), 10.0f * length * length);
+                    quadrics[a].add(border);
+                    quadrics[b].add(border);
+                }
+                if (kinds[a] == VERTEX_MANIFOLD) kinds[a] = VERTEX_BORDER;
+                if (kinds[b] == VERTEX_MANIFOLD) kinds[b] = VERTEX_BORDER;
+            }
+            else if (use > 2)
+            {
+                kinds[a] = kinds[b] = VERTEX_LOCKED;
+            }
+        }
+    }
+
+    struct Collapse
+    {
+        unsigned int from, to;
+        double cost;
+    };
+
+    std::vector<Collapse> collapses;
+    std::vector<bool> isTouched(nPositions);
+    std::vector<unsigned int> vertexRemap(nVertices);
+    std::vector<size_t> adjacencyStart(nPositions + 1);
+    std::vector<unsigned int> adjacency;
+    double maxCost = 0.0;
+    double maxAllowedCost = (double)targetError * targetError;
+
+    while (destination.size() > targetIndexCount)
+    {
+        size_t nTriangles = destination.size() / 3;
+
+        // Triangles autour de chaque position, pour le test de retournement.
+        std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+        for (unsigned int v : destination)
+            adjacencyStart[positionOf[v] + 1]++;
+        for (size_t p = 0; p < nPositions; p++)
+            adjacencyStart[p + 1] += adjacencyStart[p];
+        adjacency.resize(destination.size());
+        {
+            std::vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+            for (size_t i = 0; i < destination.size(); i++)
+                adjacency[fill[positionOf[destination[i]]]++] = (unsigned int)(i / 3);
+        }
+
+        // Meilleure direction de contraction pour chaque arête.
+        collapses.clear();
+        edgeUse.clear();
+        for (size_t i = 0; i < destination.size(); i += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = positionOf[destination[i + k]];
+                unsigned int b = positionOf[destination[i + (k + 1) % 3]];
+                edgeUse[getEdgeKey(a, b)]++;
+            }
+        }
+
+        for (const auto& entry : edgeUse)
+        {
+            unsigned int a = (unsigned int)(entry.first >> 32);
+            unsigned int b = (unsigned int)(entry.first & 0xFFFFFFFF);
+            bool isBorderEdge = entry.second == 1;
+
+            Quadric q = quadrics[a];
+            q.add(quadrics[b]);
+
+            Collapse best = { 0, 0, -1.0 };
+            for (int direction = 0; direction < 2; direction++)
+            {
+                unsigned int from = direction == 0 ? a : b;
+                unsigned int to = direction == 0 ? b : a;
+                if (kinds[from] == VERTEX_LOCKED || (kinds[from] == VERTEX_BORDER && !isBorderEdge))
+                    continue;
+
+                double cost = q.evaluate(positions[to]);
+                if (best.cost < 0.0 || cost < best.cost)
+                    best = { from, to, cost };
+            }
+            if (best.cost >= 0.0 && best.cost <= maxAllowedCost)
+                collapses.push_back(best);
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+        // Chaque contraction retire environ deux triangles.
+        size_t neededCollapses = (nTriangles - targetIndexCount / 3) / 2 + 1;
+        size_t appliedCollapses = 0;
+        std::fill(isTouched.begin(), isTouched.end(), false);
+        for (size_t v = 0; v < nVertices; v++)
+            vertexRemap[v] = (unsigned int)v;
+
+        for (const Collapse& collapse : collapses)
+        {
+            if (appliedCollapses >= neededCollapses)
+                break;
+            if (isTouched[collapse.from] || isTouched[collapse.to])
+                continue;
+
+            // Refus si un triangle restant autour de from se retourne ou devient dégénéré.
+            bool isFlipped = false;
+            for (size_t j = adjacencyStart[collapse.from]; j < adjacencyStart[collapse.from + 1] && !isFlipped; j++)
+            {
+                const unsigned int* t = &destination[adjacency[j] * 3];
+                unsigned int p[3] = { positionOf[t[0]], positionOf[t[1]], positionOf[t[2]] };
+                if (p[0] == collapse.to || p[1] == collapse.to || p[2] == collapse.to)
+                    continue;
+
+                glm::vec3 before[3] = { positions[p[0]], positions[p[1]], positions[p[2]] };
+                glm::vec3 after[3] = { before[0], before[1], before[2] };
+                for (int k = 0; k < 3; k++)
+                    if (p[k] == collapse.from)
+                        after[k] = positions[collapse.to];
+
+                glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                isFlipped = glm::dot(n0, n1) <= 0.25f * glm::length(n0) * glm::length(n1);
+            }
+            if (isFlipped)
+                continue;
+
+            // Chaque vertex de from est remplacé par le vertex de to aux attributs les plus proches.
+            for (size_t w = wedgeStart[collapse.from]; w < wedgeStart[collapse.from + 1]; w++)
+            {
+                const VertexModel& source = vertices[wedges[w]];
+                unsigned int bestVertex = wedges[wedgeStart[collapse.to]];
+                float bestDistance = -1.0f;
+                for (size_t c = wedgeStart[collapse.to]; c < wedgeStart[collapse.to + 1]; c++)
+                {
+                    const VertexModel& candidate = vertices[wedges[c]];
+                    glm::vec3 dn(candidate.normal.x - source.normal.x, candidate.normal.y - source.normal.y, candidate.normal.z - source.normal.z);
+                    float ds = candidate.texCoord.s - source.texCoord.s;
+                    float dt = candidate.texCoord.t - source.texCoord.t;
+                    float distance = glm::dot(dn, dn) + ds * ds + dt * dt;
+                    if (bestDistance < 0.0f || distance < bestDistance)
+                    {
+                        bestVertex = wedges[c];
+                        bestDistance = distance;
+                    }
+                }
+                vertexRemap[wedges[w]] = bestVertex;
+            }
+
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            isTouched[collapse.from] = isTouched[collapse.to] = true;
+            // Les voisins de from voient leurs triangles changer, on ne les contracte plus dans cette passe.
+            for (size_t j = adjacencyStart[collapse.from]; j < adjacencyStart[collapse.from + 1]; j++)
+            {
+                const unsigned int* t = &destination[adjacency[j] * 3];
+                for (int k = 0; k < 3; k++)
+                    isTouched[positionOf[t[k]]] = true;
+            }
+            maxCost = std::max(maxCost, collapse.cost);
+            appliedCollapses++;
+        }
+
+        if (appliedCollapses == 0)
+            break;
+
+        // Application des remplacements et retrait des triangles dégénérés.
+        size_t write = 0;
+        for (size_t i = 0; i < destination.size(); i += 3)
+        {
+            unsigned int v0 = vertexRemap[destination[i]];
+            unsigned int v1 = vertexRemap[destination[i + 1]];
+            unsigned int v2 = vertexRemap[destination[i + 2]];
+            unsigned int p0 = positionOf[v0], p1 = positionOf[v1], p2 = positionOf[v2];
+            if (p0 == p1 || p1 == p2 || p0 == p2)
+                continue;
+
+            destination[write++] = v0;
+            destination[write++] = v1;
+            destination[write++] = v2;
+        }
+        destination.resize(write);
+    }
+
+    return (float)std::sqrt(maxCost);
+}
+
+void generateMeshLods(MeshData& mesh, size_t maxLods)
+{
+    // Taille du modèle, pour ramener l'erreur relative dans l'espace du modèle.
+    glm::vec3 minPos(0.0f), maxPos(0.0f);
+    if (!mesh.vertices.empty())
+        minPos = maxPos = toVec3(mesh.vertices[0].pos);
+    for (const VertexModel& v : mesh.vertices)
+    {
+        minPos = glm::min(minPos, toVec3(v.pos));
+        maxPos = glm::max(maxPos, toVec3(v.pos));
+    }
+    glm::vec3 extent = maxPos - minPos;
+    float size = std::max(std::max(extent.x, extent.y), extent.z);
+
+    // Au-delà de 10% de la taille du modèle, la silhouette change trop pour le contour.
+    const float MAX_RELATIVE_ERROR = 0.1f;
+    const size_t MIN_TRIANGLES = 8;
+
+    mesh.lods.clear();
+    mesh.lods.reserve(maxLods);
+    const std::vector<unsigned int>* previous = &mesh.indices;
+    for (size_t i = 0; i < maxLods; i++)
+    {
+        size_t target = (previous->size() / 3 / 2) * 3;
+        if (target < MIN_TRIANGLES * 3)
+            break;
+
+        MeshLodData lod;
+        float error = simplifyMesh(lod.indices, mesh.vertices.data(), mesh.vertices.size(),
+                                   mesh.indices.data(), mesh.indices.size(), target, MAX_RELATIVE_ERROR);
+
+        // Un niveau qui ne retire pas au moins 20% des triangles du précédent ne vaut pas un appel.
+        if (lod.indices.size() * 5 > previous->size() * 4)
+            break;
+
+        std::vector<unsigned int> optimized(lod.indices.size());
+        optimizeVertexCache(optimized.data(), lod.indices.data(), lod.indices.size(), mesh.vertices.size());
+        lod.indices.swap(optimized);
+        lod.error = error * size;
+
+        mesh.lods.push_back(std::move(lod));
+        previous = &mesh.lods.back().indices;
+    }
+
+    mesh.attributes |= MESH_HAS_LODS;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "mesh.hpp"
+
+// Simplification par contraction d'arêtes guidée par des quadriques d'erreur (Garland et Heckbert 1997).
+// Les vertex ne sont pas modifiés: le résultat est une nouvelle liste d'indices sur le même tableau,
+// ce qui permet aux niveaux de détail de partager le buffer de vertex du maillage.
+// targetError et l'erreur retournée sont relatifs à la plus grande dimension de la boîte englobante.
+float simplifyMesh(std::vector<unsigned int>& destination, const VertexModel* vertices, size_t nVertices,
+                   const unsigned int* indices, size_t nIndices, size_t targetIndexCount, float targetError);
+
+// Ajoute à mesh.lods jusqu'à maxLods niveaux ayant chacun environ la moitié des triangles du précédent.
+// Le maillage est marqué MESH_HAS_LODS même si aucun niveau utile n'a pu être produit.
+void generateMeshLods(MeshData& mesh, size_t maxLods = 3);
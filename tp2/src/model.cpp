@@ -2,43 +2,85 @@
 #include <glm/glm.hpp>
 #include "happly.h"
 
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
 using namespace gl;
 using namespace glm;
 
-struct PositionAttribute
-{
-    float x, y, z;
-};
+bool Model::optimizeOnLoad = true;
+bool Model::generateLods = true;
 
-struct ColorUCharAttribute
-{
-    unsigned char r, g, b;
-};
+static const unsigned char CULLED_LOD = 0xFF;
 
-struct NormalAttribute
+static float getMaxScale(const glm::mat4& model)
 {
-    float x, y, z;
-};
+    return std::max(std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))), glm::length(glm::vec3(model[2])));
+}
 
-struct TexCoordAttribute
+Model::Model()
+: pool_(&MeshPool::get()), range_{}, bounds_{}, instances_{ 0, 0 }, instanceCount_(0), visibleInstanceCount_(0)
 {
-    float s, t;
-};
 
-struct VertexModel
+}
+
+ModelStaging Model::prepare(const char* path)
 {
-    PositionAttribute pos;
-    ColorUCharAttribute color;
-    NormalAttribute normal;
-    TexCoordAttribute texCoord;
-};
+    // Le cache est déjà au format compact: il reste projeté jusqu'à l'envoi, sans copie.
+    ModelStaging staging;
+    staging.cacheFile = std::make_shared<MappedFile>();
+    if (openCachedMesh(path, *staging.cacheFile, staging.cached))
+    {
+        bool needsOptimize = optimizeOnLoad && !(staging.cached.attributes & MESH_IS_OPTIMIZED);
+        bool needsLods = generateLods && !(staging.cached.attributes & MESH_HAS_LODS);
+        if (!needsOptimize && !needsLods)
+            return staging;
+
+        // Le cache ne garde pas les vertex d'origine: on repart du PLY.
+        staging.cacheFile->close();
+    }
+    staging.cacheFile.reset();
+
+    MeshData mesh = parse(path);
+    if (optimizeOnLoad)
+    {
+        VertexCacheStats before, after;
+        optimizeMesh(mesh, &before, &after);
 
-const GLuint VERTEX_POSITION_INDEX = 0;
-const GLuint VERTEX_COLOR_INDEX = 1;
-const GLuint VERTEX_NORMAL_INDEX = 2;
-const GLuint VERTEX_TEXCOORDS_INDEX = 3;
+        std::ostringstream report;
+        report << "Optimized model \"" << path << "\": ACMR " << before.acmr << " -> " << after.acmr
+               << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+        std::cout << report.str();
+    }
+    if (generateLods)
+        generateMeshLods(mesh);
+
+    staging.mesh = compactMesh(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size(),
+                               mesh.lods.data(), mesh.lods.size());
+    if (!writeCachedMesh(path, staging.mesh, mesh.attributes))
+        std::cout << "Could not write mesh cache for model \"" << path << "\"" << std::endl;
+    return staging;
+}
 
 void Model::load(const char* path)
+{
+    load(prepare(path));
+}
+
+void Model::load(const ModelStaging& staging)
+{
+    if (staging.cacheFile)
+        upload(staging.cached);
+    else
+        upload(staging.mesh);
+}
+
+MeshData Model::parse(const char* path)
 {
     happly::PLYData plyIn(path);
 
@@ -82,9 +124,16 @@ void Model::load(const char* path)
         std::cout << "No texture coordinate attribute for model \"" << path << "\"" << std::endl;
     }
 
-    std::vector<std::vector<unsigned int>> facesIndices = plyIn.getFaceIndices<unsigned int>();
+    MeshData mesh;
+    if (!colorRed.empty())
+        mesh.attributes |= MESH_HAS_COLOR;
+    if (!normalX.empty())
+        mesh.attributes |= MESH_HAS_NORMAL;
+    if (!texCoordsX.empty())
+        mesh.attributes |= MESH_HAS_TEXCOORDS;
 
-    std::vector<VertexModel> vPos(positionX.size());
+    std::vector<VertexModel>& vPos = mesh.vertices;
+    vPos.resize(positionX.size());
     for (size_t i = 0; i < vPos.size(); i++)
     {
         vPos[i] = { 0 };
@@ -114,100 +163,193 @@ void Model::load(const char* path)
         }
     }
 
-    std::vector<unsigned int> elementsData(facesIndices.size() * 3);
-    for (size_t i = 0; i < facesIndices.size(); i++)
-    {
-        for (size_t j = 0; j < facesIndices[i].size(); j++)
-        {
-            elementsData[3 * i + j] = facesIndices[i][j];
-        }
-    }
+    mesh.indices = plyIn.getTriangleIndicesFlat<unsigned int>();
 
-    glGenBuffers(1, &vbo_);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-    glBufferData(GL_ARRAY_BUFFER, vPos.size() * sizeof(VertexModel), &vPos[0], GL_STATIC_DRAW);
+    return mesh;
+}
 
-    glGenBuffers(1, &ebo_);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, elementsData.size() * sizeof(unsigned int), &elementsData[0], GL_STATIC_DRAW);
+void Model::upload(const VertexModel* vertices, size_t nVertices, const unsigned int* indices, size_t nIndices)
+{
+    pool_ = &MeshPool::get(VertexFormat::Full);
+    range_ = pool_->allocate(vertices, nVertices, indices, nIndices, GL_UNSIGNED_INT);
+    bounds_ = computeMeshBounds(vertices, nVertices);
+}
 
-    glGenVertexArrays(1, &vao_);
-    glBindVertexArray(vao_);
+void Model::upload(const CompactMeshData& mesh)
+{
+    // Même chemin que le cache: une vue sur les blocs du maillage.
+    CachedMeshView view;
+    view.vertices = mesh.vertices.data();
+    view.vertexCount = mesh.vertices.size();
+    bool is16Bit = !mesh.indices16.empty();
+    view.indices = is16Bit ? (const void*)mesh.indices16.data() : (const void*)mesh.indices.data();
+    view.indexCount = is16Bit ? mesh.indices16.size() : mesh.indices.size();
+    view.indexSize = is16Bit ? sizeof(uint16_t) : sizeof(unsigned int);
+    for (const CompactMeshLod& lod : mesh.lods)
+    {
+        if (is16Bit)
+            view.lods.push_back({ lod.indices16.data(), lod.indices16.size(), lod.error });
+        else
+            view.lods.push_back({ lod.indices.data(), lod.indices.size(), lod.error });
+    }
+    view.bounds = mesh.bounds;
+    view.positionScale = mesh.positionScale;
+    view.positionOffset = mesh.positionOffset;
+    view.attributes = 0;
+    upload(view);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+void Model::upload(const CachedMeshView& mesh)
+{
+    pool_ = &MeshPool::get(VertexFormat::Compact);
+    GLenum indexType = mesh.indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    range_ = pool_->allocate(mesh.vertices, mesh.vertexCount, mesh.indices, mesh.indexCount, indexType);
+    range_.positionScale = mesh.positionScale;
+    range_.positionOffset = mesh.positionOffset;
+    bounds_ = mesh.bounds;
+
+    lods_.clear();
+    for (const CachedLodView& lod : mesh.lods)
+    {
+        Lod level;
+        level.range = pool_->allocateIndices(range_, lod.indices, lod.indexCount);
+        level.error = lod.error;
+        lods_.push_back(level);
+    }
+}
 
-    glEnableVertexAttribArray(VERTEX_POSITION_INDEX);
-    glVertexAttribPointer(VERTEX_POSITION_INDEX, 3, GL_FLOAT, GL_FALSE, sizeof(VertexModel), (GLvoid*)(offsetof(VertexModel, pos)));
+void Model::load(float* vertices, size_t verticesSize, unsigned int* elements, size_t elementsSize)
+{
+    // Position et coordonnées de texture entrelacées, converties au format commun du MeshPool.
+    const size_t FLOATS_PER_VERTEX = 5;
+    size_t nVertices = verticesSize / (FLOATS_PER_VERTEX * sizeof(float));
 
-    if (!colorRed.empty())
+    std::vector<VertexModel> vertexData(nVertices);
+    for (size_t i = 0; i < nVertices; i++)
     {
-        glEnableVertexAttribArray(VERTEX_COLOR_INDEX);
-        glVertexAttribPointer(VERTEX_COLOR_INDEX, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexModel), (GLvoid*)(offsetof(VertexModel, color)));
+        const float* v = &vertices[i * FLOATS_PER_VERTEX];
+        vertexData[i] = { 0 };
+        vertexData[i].pos = { v[0], v[1], v[2] };
+        vertexData[i].texCoord = { v[3], v[4] };
     }
-    else
-        glDisableVertexAttribArray(VERTEX_COLOR_INDEX);
 
-    if (!normalX.empty())
+    upload(vertexData.data(), nVertices, elements, elementsSize / sizeof(unsigned int));
+}
+
+void Model::setInstanceMatrices(const glm::mat4* matrices, GLsizei count)
+{
+    if (count > instances_.capacity)
+        instances_ = pool_->allocateInstances(count);
+
+    pool_->updateInstances(instances_, matrices, count);
+    instanceCount_ = count;
+    visibleInstanceCount_ = count;
+
+    // Tant que updateInstances n'est pas appelé, toutes les instances sont au niveau 0.
+    instanceMatrices_.assign(matrices, matrices + count);
+    instanceLods_.assign(count, 0);
+    lodInstanceCounts_.assign(lods_.size() + 1, 0);
+    lodInstanceCounts_[0] = count;
+}
+
+int Model::selectLod(const glm::mat4& model, const LodSelection& selection) const
+{
+    glm::vec3 position(model[3]);
+    float distance = std::max(glm::length(position - selection.cameraPosition), 1e-3f);
+    float scale = getMaxScale(model);
+
+    for (int i = (int)lods_.size(); i > 0; i--)
     {
-        glEnableVertexAttribArray(VERTEX_NORMAL_INDEX);
-        glVertexAttribPointer(VERTEX_NORMAL_INDEX, 3, GL_FLOAT, GL_FALSE, sizeof(VertexModel), (GLvoid*)(offsetof(VertexModel, normal)));
+        float pixelError = lods_[i - 1].error * scale * selection.pixelsPerUnit / distance;
+        if (pixelError <= selection.maxPixelError)
+            return i;
     }
-    else
-        glDisableVertexAttribArray(VERTEX_NORMAL_INDEX);
+    return 0;
+}
 
-    if (!texCoordsX.empty())
+bool Model::isVisible(const glm::mat4& model, const Frustum& frustum) const
+{
+    // Boîte transformée: le centre suit la matrice, les demi-côtés passent par sa valeur absolue.
+    glm::vec3 center = glm::vec3(model * glm::vec4((bounds_.min + bounds_.max) * 0.5f, 1.0f));
+    glm::vec3 halfExtent = (bounds_.max - bounds_.min) * 0.5f;
+    glm::vec3 extent(0.0f);
+    for (int column = 0; column < 3; column++)
     {
-        glEnableVertexAttribArray(VERTEX_TEXCOORDS_INDEX);
-        glVertexAttribPointer(VERTEX_TEXCOORDS_INDEX, 2, GL_FLOAT, GL_FALSE, sizeof(VertexModel), (GLvoid*)(offsetof(VertexModel, texCoord)));
+        glm::vec3 axis(model[column]);
+        extent += glm::vec3(std::fabs(axis.x), std::fabs(axis.y), std::fabs(axis.z)) * halfExtent[column];
     }
-    else
-        glDisableVertexAttribArray(VERTEX_TEXCOORDS_INDEX);
-
-    glBindVertexArray(0);
-
-    count_ = elementsData.size();
+    return isBoxVisible(frustum, center, extent);
 }
 
-void Model::load(float* vertices, size_t verticesSize, unsigned int* elements, size_t elementsSize)
+void Model::updateInstances(const Frustum& frustum, const LodSelection& selection)
 {
-    glGenBuffers(1, &vbo_);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-    glBufferData(GL_ARRAY_BUFFER, verticesSize, vertices, GL_STATIC_DRAW);
+    if (instanceCount_ == 0)
+        return;
 
-    glGenBuffers(1, &ebo_);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, elementsSize, elements, GL_STATIC_DRAW);
+    // Sphères englobantes des instances en SoA pour le test par lots.
+    std::vector<float> x(instanceCount_), y(instanceCount_), z(instanceCount_), radius(instanceCount_);
+    for (GLsizei i = 0; i < instanceCount_; i++)
+    {
+        const glm::mat4& model = instanceMatrices_[i];
+        glm::vec3 center = glm::vec3(model * glm::vec4(bounds_.center, 1.0f));
+        x[i] = center.x;
+        y[i] = center.y;
+        z[i] = center.z;
+        radius[i] = bounds_.radius * getMaxScale(model);
+    }
 
-    glGenVertexArrays(1, &vao_);
-    glBindVertexArray(vao_);
+    std::vector<unsigned char> visible(instanceCount_);
+    cullSpheres(frustum, x.data(), y.data(), z.data(), radius.data(), instanceCount_, visible.data());
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+    std::vector<unsigned char> instanceLods(instanceCount_);
+    for (GLsizei i = 0; i < instanceCount_; i++)
+        instanceLods[i] = visible[i] ? (unsigned char)selectLod(instanceMatrices_[i], selection) : CULLED_LOD;
 
-    glEnableVertexAttribArray(VERTEX_POSITION_INDEX);
-    glVertexAttribPointer(VERTEX_POSITION_INDEX, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (GLvoid*)(0));
+    if (instanceLods == instanceLods_)
+        return;
+    instanceLods_.swap(instanceLods);
 
-    glDisableVertexAttribArray(VERTEX_COLOR_INDEX);
-    glDisableVertexAttribArray(VERTEX_NORMAL_INDEX);
+    // Tri par comptage: les instances d'un même niveau deviennent contiguës, celles hors champ disparaissent.
+    lodInstanceCounts_.assign(lods_.size() + 1, 0);
+    for (unsigned char lod : instanceLods_)
+    {
+        if (lod != CULLED_LOD)
+            lodInstanceCounts_[lod]++;
+    }
 
-    glEnableVertexAttribArray(VERTEX_TEXCOORDS_INDEX);
-    glVertexAttribPointer(VERTEX_TEXCOORDS_INDEX, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (GLvoid*)(3 * sizeof(float)));
+    std::vector<GLsizei> offsets(lodInstanceCounts_.size(), 0);
+    for (size_t lod = 1; lod < offsets.size(); lod++)
+        offsets[lod] = offsets[lod - 1] + lodInstanceCounts_[lod - 1];
+    visibleInstanceCount_ = offsets.back() + lodInstanceCounts_.back();
 
-    glBindVertexArray(0);
+    std::vector<glm::mat4> sorted(visibleInstanceCount_);
+    for (GLsizei i = 0; i < instanceCount_; i++)
+    {
+        if (instanceLods_[i] != CULLED_LOD)
+            sorted[offsets[instanceLods_[i]]++] = instanceMatrices_[i];
+    }
 
-    count_ = elementsSize / sizeof(unsigned int);
+    if (visibleInstanceCount_ > 0)
+        pool_->updateInstances(instances_, sorted.data(), visibleInstanceCount_);
 }
 
-Model::~Model()
+void Model::draw(int lod)
 {
-    glDeleteBuffers(1, &ebo_);
-    glDeleteBuffers(1, &vbo_);
-    glDeleteVertexArrays(1, &vao_);
+    lod = std::min(lod, (int)lods_.size());
+    pool_->draw(lod == 0 ? range_ : lods_[lod - 1].range);
 }
 
-void Model::draw()
+void Model::drawInstanced()
 {
-    glBindVertexArray(vao_);
-    glDrawElements(GL_TRIANGLES, count_, GL_UNSIGNED_INT, 0);
-}
\ No newline at end of file
+    GLuint first = 0;
+    for (size_t lod = 0; lod < lodInstanceCounts_.size(); lod++)
+    {
+        GLsizei count = lodInstanceCounts_[lod];
+        if (count == 0)
+            continue;
+
+        InstanceRange instances = { instances_.baseInstance + first, count };
+        pool_->drawInstanced(lod == 0 ? range_ : lods_[lod - 1].range, instances, count);
+        first += count;
+    }
+}
@@ -1,21 +1,91 @@
 #pragma once
 
 #include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+#include "frustum.hpp"
+#include "mesh.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_pool.hpp"
 
 using namespace gl;
 
+// Données d'un modèle prêtes à être envoyées au GPU. Produites sans appel OpenGL,
+// donc sur n'importe quel thread, puis consommées par Model::load sur le thread OpenGL.
+struct ModelStaging
+{
+    // Cache valide: projeté en mémoire et envoyé tel quel aux buffers par Model::load.
+    std::shared_ptr<MappedFile> cacheFile;
+    CachedMeshView cached;
+    // Sinon, maillage quantifié à partir du PLY.
+    CompactMeshData mesh;
+};
+
+// Paramètres de sélection du niveau de détail pour la vue courante.
+struct LodSelection
+{
+    glm::vec3 cameraPosition;
+    float pixelsPerUnit; // Taille en pixels d'une unité vue à distance 1: hauteur / (2 tan(fov / 2)).
+    float maxPixelError; // Erreur géométrique tolérée à l'écran.
+};
+
 class Model
 {
 public:
+    Model();
+
+    // Réordonne triangles et vertex au chargement (voir mesh_optimizer.hpp), le résultat est gardé dans le cache.
+    static bool optimizeOnLoad;
+    // Génère des niveaux de détail simplifiés au chargement (voir mesh_simplifier.hpp), aussi gardés dans le cache.
+    static bool generateLods;
+
+    static ModelStaging prepare(const char* path);
+
     void load(const char* path);
+    void load(const ModelStaging& staging);
     void load(float* vertices, size_t verticesSize, unsigned int* elements, size_t elementsSize);
     
-    ~Model();
-    
-    void draw();
+    void setInstanceMatrices(const glm::mat4* matrices, GLsizei count);
+
+    const MeshBounds& getBounds() const { return bounds_; }
+    bool isVisible(const glm::mat4& model, const Frustum& frustum) const;
+
+    // Niveau le moins détaillé dont l'erreur projetée reste sous selection.maxPixelError, 0 étant le maillage complet.
+    int selectLod(const glm::mat4& model, const LodSelection& selection) const;
+    // Retire les instances hors du volume de vue et regroupe les autres par niveau de détail.
+    // Les matrices ne sont renvoyées que si le regroupement change.
+    void updateInstances(const Frustum& frustum, const LodSelection& selection);
+    GLsizei getInstanceCount() const { return instanceCount_; }
+    GLsizei getVisibleInstanceCount() const { return visibleInstanceCount_; }
+
+    void draw(int lod = 0);
+    void drawInstanced(); // Un appel par niveau de détail utilisé.
 
 private:
-    GLuint vao_, vbo_, ebo_;
-    GLsizei count_;
-};
+    static MeshData parse(const char* path);
+    void upload(const VertexModel* vertices, size_t nVertices, const unsigned int* indices, size_t nIndices);
+    void upload(const CompactMeshData& mesh);
+    void upload(const CachedMeshView& mesh);
+
+    struct Lod
+    {
+        MeshRange range;
+        float error; // Dans l'espace du modèle.
+    };
 
+    // La géométrie vit dans le MeshPool partagé, le modèle n'en garde que l'emplacement.
+    MeshPool* pool_;
+    MeshRange range_;
+    std::vector<Lod> lods_; // lods_[i] est le niveau i + 1.
+    MeshBounds bounds_;
+
+    InstanceRange instances_;
+    GLsizei instanceCount_;
+    GLsizei visibleInstanceCount_;
+    std::vector<glm::mat4> instanceMatrices_;
+    std::vector<unsigned char> instanceLods_; // CULLED_LOD pour les instances hors champ.
+    std::vector<GLsizei> lodInstanceCounts_; // Les instances sont rangées par niveau dans instances_.
+};
@@ -0,0 +1,171 @@
+#include "program_cache.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <vector>
+
+#include "mesh_cache.hpp"
+
+static const char PROGRAM_CACHE_MAGIC[4] = { 'P', 'R', 'O', 'G' };
+static const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+static const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+static const uint64_t FNV_PRIME = 1099511628211ull;
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t hashGLString(uint64_t hash, GLenum name)
+{
+    const char* value = (const char*)glGetString(name);
+    // Le zéro final sépare les chaînes: "ab" + "c" et "a" + "bc" donnent des clés différentes.
+    return value ? hashBytes(hash, value, strlen(value) + 1) : hash;
+}
+
+static bool hasGetProgramBinary()
+{
+    GLint major = 0;
+    GLint minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 1))
+        return true;
+
+    GLint nExtensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &nExtensions);
+    for (GLint i = 0; i < nExtensions; i++)
+    {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_get_program_binary") == 0)
+            return true;
+    }
+    return false;
+}
+
+bool isProgramBinarySupported()
+{
+    // Une seule requête: sans l'extension, GL_NUM_PROGRAM_BINARY_FORMATS est une énumération invalide.
+    static bool isQueried = false;
+    static GLint nFormats = 0;
+    if (!isQueried)
+    {
+        isQueried = true;
+        if (hasGetProgramBinary())
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nFormats);
+    }
+    return nFormats > 0;
+}
+
+uint64_t getProgramCacheSeed()
+{
+    static uint64_t seed = 0;
+    if (!seed)
+    {
+        seed = hashBytes(FNV_OFFSET_BASIS, &PROGRAM_CACHE_VERSION, sizeof(PROGRAM_CACHE_VERSION));
+        seed = hashGLString(seed, GL_VENDOR);
+        seed = hashGLString(seed, GL_RENDERER);
+        seed = hashGLString(seed, GL_VERSION);
+    }
+    return seed;
+}
+
+uint64_t hashProgramSource(uint64_t hash, const std::string& source)
+{
+    return hashBytes(hash, source.c_str(), source.size() + 1);
+}
+
+std::string getProgramCachePath(const char* programName)
+{
+    return std::string(PROGRAM_CACHE_DIRECTORY) + "/" + programName + ".programcache";
+}
+
+bool loadCachedProgram(const char* programName, uint64_t key, GLuint program)
+{
+    if (!isProgramBinarySupported())
+        return false;
+
+    std::string cachePath = getProgramCachePath(programName);
+    MappedFile file;
+    if (!file.open(cachePath.c_str()))
+        return false;
+
+    ProgramCacheHeader header = {};
+    if (file.size() >= sizeof(ProgramCacheHeader))
+        memcpy(&header, file.data(), sizeof(ProgramCacheHeader));
+
+    bool isValid = memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC)) == 0
+                && header.version == PROGRAM_CACHE_VERSION
+                && header.key == key
+                && file.size() == sizeof(ProgramCacheHeader) + header.binarySize;
+    if (!isValid)
+        return false;
+
+    glProgramBinary(program, (GLenum)header.binaryFormat, file.data() + sizeof(ProgramCacheHeader), (GLsizei)header.binarySize);
+
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        std::cout << "Program cache \"" << cachePath << "\" rejected by the driver, compiling sources." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool writeCachedProgram(const char* programName, uint64_t key, GLuint program)
+{
+    if (!isProgramBinarySupported())
+        return false;
+
+    GLint binarySize = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+    if (binarySize <= 0)
+        return false;
+
+    std::vector<char> binary(binarySize);
+    GLenum binaryFormat;
+    glGetProgramBinary(program, binarySize, nullptr, &binaryFormat, binary.data());
+
+    ProgramCacheHeader header = {};
+    memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = key;
+    header.binaryFormat = (uint32_t)binaryFormat;
+    header.binarySize = (uint32_t)binarySize;
+
+    std::error_code error;
+    std::filesystem::create_directories(PROGRAM_CACHE_DIRECTORY, error);
+
+    // Même écriture atomique que le cache de maillages.
+    std::string cachePath = getProgramCachePath(programName);
+    std::string tmpPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        out.write((const char*)&header, sizeof(header));
+        out.write(binary.data(), binary.size());
+        if (!out)
+            return false;
+    }
+
+    std::filesystem::rename(tmpPath, cachePath, error);
+    if (error)
+    {
+        std::cout << "Could not write program cache \"" << cachePath << "\": " << error.message() << std::endl;
+        std::filesystem::remove(tmpPath, error);
+        return false;
+    }
+    return true;
+}
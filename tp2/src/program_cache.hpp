@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glbinding/gl/gl.h>
+
+#include <cstdint>
+#include <string>
+
+using namespace gl;
+
+// Binaire d'un programme lié: un en-tête puis les octets de glGetProgramBinary.
+// La clé couvre les sources passées au compilateur et l'identité du pilote; un binaire que
+// le pilote refuse malgré tout (mise à jour sans changement de version) est recompilé.
+struct ProgramCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t binarySize;
+};
+
+// Hors de ./shaders/, que ShaderWatcher surveille: les écritures du cache n'y créent pas d'événements.
+const char* const PROGRAM_CACHE_DIRECTORY = "./shader_cache";
+
+// Faux si le pilote n'offre aucun format binaire (GL_ARB_get_program_binary absent).
+bool isProgramBinarySupported();
+
+// FNV-1a 64 bits, à enchaîner sur chaque source. La graine contient GL_RENDERER et GL_VERSION.
+uint64_t getProgramCacheSeed();
+uint64_t hashProgramSource(uint64_t hash, const std::string& source);
+
+std::string getProgramCachePath(const char* programName);
+
+// Charge le binaire dans program et vérifie qu'il est lié.
+bool loadCachedProgram(const char* programName, uint64_t key, GLuint program);
+bool writeCachedProgram(const char* programName, uint64_t key, GLuint program);
@@ -0,0 +1,328 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+
+#include "gl_state.hpp"
+#include "light_manager.hpp"
+#include "model.hpp"
+#include "shaders.hpp"
+#include "textures.hpp"
+#include "transform_ring.hpp"
+#include "weighted_transparency.hpp"
+
+// Champs de la clé, du poids fort au poids faible.
+const int KEY_PASS_SHIFT        = 61;
+const int KEY_SHADER_SHIFT      = 59;
+const int KEY_PERMUTATION_SHIFT = 56;
+const int KEY_STATE_SHIFT       = 50;
+const int KEY_TEXTURE_SHIFT     = 41;
+const int KEY_MATERIAL_SHIFT    = 33;
+const int KEY_DEPTH_SHIFT       = 16; // Profondeur des passes groupées par état, 17 bits de poids fort.
+const int KEY_SORTED_DEPTH_SHIFT = 41; // Profondeur de la passe triée en profondeur.
+
+const uint64_t KEY_PERMUTATION_MASK = (1 << 3) - 1;
+const uint64_t KEY_STATE_MASK    = (1 << 6) - 1;
+const uint64_t KEY_TEXTURE_MASK  = (1 << 9) - 1;
+const uint64_t KEY_MATERIAL_MASK = (1 << 8) - 1;
+const uint64_t KEY_DEPTH_MAX     = (1 << 20) - 1;
+const int KEY_GROUPED_DEPTH_DROP = 3;
+const uint64_t KEY_SEQUENCE_MASK = (1 << 16) - 1;
+
+RenderQueue::StateTracker::StateTracker()
+: shader(-1), permutation(0), isProgramReady(true), texture(nullptr), cubeMap(nullptr), material(0), hasMaterial(false)
+, state(0), drawId(0), hasDrawId(false)
+{
+
+}
+
+RenderQueue::RenderQueue()
+: isEdgeEffectEnabled(true)
+, celShadingShader(nullptr), edgeEffectShader(nullptr), skyShader(nullptr)
+, materials(nullptr), transforms(nullptr), lights(nullptr)
+, transparency(nullptr), transparencyCompositeShader(nullptr)
+, cameraPosition_(0.0f), maxDepth_(1.0f), stats_{}
+{
+
+}
+
+void RenderQueue::reset(const glm::vec3& cameraPosition, float maxDepth)
+{
+    cameraPosition_ = cameraPosition;
+    maxDepth_ = maxDepth;
+    packets_.clear();
+    keys_.clear();
+}
+
+void RenderQueue::submit(RenderPass pass, const DrawPacket& packet, const glm::vec3& worldPosition)
+{
+    // Anneau de transformations plein: le dessin n'a pas de matrices cette image.
+    if (!packet.isInstanced && packet.shader != RenderShader::Sky && packet.drawId == INVALID_DRAW_ID)
+        return;
+
+    DrawPacket permuted = packet;
+    permuted.permutation = selectPermutation(packet);
+    keys_.push_back(makeKey(pass, permuted, glm::length(worldPosition - cameraPosition_)));
+    packets_.push_back(permuted);
+}
+
+void RenderQueue::submitOutlined(RenderPass pass, const DrawPacket& packet, unsigned int edgeState, const glm::vec3& worldPosition)
+{
+    DrawPacket main = packet;
+    main.shader = RenderShader::CelShading;
+    main.state |= STATE_STENCIL_WRITE;
+    submit(pass, main, worldPosition);
+
+    if (!isEdgeEffectEnabled)
+        return;
+
+    DrawPacket edge = packet;
+    edge.shader = RenderShader::EdgeEffect;
+    edge.texture = nullptr;
+    // Le contour est opaque et dessiné après la composition: jamais dans les cibles pondérées.
+    edge.state = (edge.state & ~STATE_WEIGHTED_BLEND) | edgeState | STATE_STENCIL_TEST;
+    submit(pass == RenderPass::Transparent ? RenderPass::TransparentOutline : RenderPass::Outline, edge, worldPosition);
+}
+
+uint32_t RenderQueue::selectPermutation(const DrawPacket& packet) const
+{
+    if (packet.shader != RenderShader::CelShading)
+        return 0;
+
+    uint32_t permutation = 0;
+    if (packet.state & STATE_WEIGHTED_BLEND)
+        permutation |= CEL_SHADING_WEIGHTED_TRANSPARENCY;
+
+    // Les instances n'ont pas de liste, seule l'absence de tout projecteur actif les simplifie.
+    int nDrawLights = packet.isInstanced ? -1 : transforms->getDrawLightCount(packet.drawId);
+    if (nDrawLights == 0 || lights->getActiveSpotLightCount() == 0)
+        permutation |= CEL_SHADING_NO_SPOTLIGHTS;
+    else if (nDrawLights > 0)
+        permutation |= CEL_SHADING_DRAW_LIGHTS_ONLY;
+    return permutation;
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, const DrawPacket& packet, float depth) const
+{
+    uint64_t quantizedDepth = (uint64_t)(glm::clamp(depth / maxDepth_, 0.0f, 1.0f) * KEY_DEPTH_MAX);
+    // Départage les clés égales dans l'ordre de soumission.
+    uint64_t sequence = packets_.size() & KEY_SEQUENCE_MASK;
+
+    uint64_t key = (uint64_t)pass << KEY_PASS_SHIFT;
+    switch (pass)
+    {
+    case RenderPass::Outlined:
+        key |= quantizedDepth << KEY_SORTED_DEPTH_SHIFT;
+        break;
+    default:
+    {
+        GLuint texture = packet.texture ? packet.texture->getId() : packet.cubeMap ? packet.cubeMap->getId() : 0;
+        key |= (uint64_t)packet.shader << KEY_SHADER_SHIFT;
+        key |= (packet.permutation & KEY_PERMUTATION_MASK) << KEY_PERMUTATION_SHIFT;
+        key |= (packet.state & KEY_STATE_MASK) << KEY_STATE_SHIFT;
+        key |= (texture & KEY_TEXTURE_MASK) << KEY_TEXTURE_SHIFT;
+        key |= (packet.material & KEY_MATERIAL_MASK) << KEY_MATERIAL_SHIFT;
+        key |= (quantizedDepth >> KEY_GROUPED_DEPTH_DROP) << KEY_DEPTH_SHIFT;
+        break;
+    }
+    }
+    return key | sequence;
+}
+
+// Tri par base (LSD) sur des chiffres de 8 bits. Les chiffres identiques pour toutes les clés,
+// fréquents puisque la plupart des champs varient peu, sont sautés.
+void RenderQueue::sort()
+{
+    size_t n = keys_.size();
+    order_.resize(n);
+    sortBuffer_.resize(n);
+    keyBuffer_.resize(n);
+    for (size_t i = 0; i < n; i++)
+        order_[i] = (uint32_t)i;
+
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t counts[256] = {};
+        for (size_t i = 0; i < n; i++)
+            counts[(keys_[i] >> shift) & 0xFF]++;
+        if (n == 0 || counts[(keys_[0] >> shift) & 0xFF] == n)
+            continue;
+
+        size_t offset = 0;
+        for (size_t& count : counts)
+        {
+            size_t c = count;
+            count = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t dst = counts[(keys_[i] >> shift) & 0xFF]++;
+            keyBuffer_[dst] = keys_[i];
+            sortBuffer_[dst] = order_[i];
+        }
+        keys_.swap(keyBuffer_);
+        order_.swap(sortBuffer_);
+    }
+}
+
+void RenderQueue::execute()
+{
+    stats_ = {};
+    stats_.draws = (unsigned int)packets_.size();
+
+    // Ce qu'aurait coûté l'ordre de soumission, avec la même élimination des changements redondants.
+    StateTracker submitOrder;
+    for (const DrawPacket& packet : packets_)
+        stats_.submitOrderChanges += changeState(submitOrder, packet, false);
+
+    const uint64_t TRANSPARENT_PASS = (uint64_t)RenderPass::Transparent;
+
+    StateTracker current;
+    for (size_t k = 0; k < order_.size(); k++)
+    {
+        const DrawPacket& packet = packets_[order_[k]];
+        uint64_t pass = keys_[k] >> KEY_PASS_SHIFT;
+        bool isFirstTransparent = pass == TRANSPARENT_PASS && (k == 0 || (keys_[k - 1] >> KEY_PASS_SHIFT) != TRANSPARENT_PASS);
+        if (isFirstTransparent)
+            transparency->begin();
+
+        stats_.stateChanges += changeState(current, packet, true);
+
+        if (!current.isProgramReady)
+            stats_.skippedDraws++;
+        else if (packet.isInstanced)
+            packet.model->drawInstanced();
+        else
+            packet.model->draw(packet.lod);
+
+        bool isLastTransparent = pass == TRANSPARENT_PASS && (k + 1 == order_.size() || (keys_[k + 1] >> KEY_PASS_SHIFT) != TRANSPARENT_PASS);
+        if (isLastTransparent)
+        {
+            // La composition change de programme et d'état: on repart de l'état par défaut.
+            applyState(current.state, 0);
+            current = StateTracker();
+            transparency->end(*transparencyCompositeShader);
+        }
+    }
+
+    // Le reste du rendu suppose l'état par défaut.
+    applyState(current.state, 0);
+}
+
+unsigned int RenderQueue::changeState(StateTracker& tracker, const DrawPacket& packet, bool apply)
+{
+    unsigned int nChanges = 0;
+
+    if (tracker.shader != (int)packet.shader || tracker.permutation != packet.permutation)
+    {
+        tracker.shader = (int)packet.shader;
+        tracker.permutation = packet.permutation;
+        tracker.isProgramReady = true;
+        nChanges++;
+        if (apply)
+            stats_.programSwitches++;
+        if (apply)
+        {
+            switch (packet.shader)
+            {
+            case RenderShader::CelShading:
+                tracker.isProgramReady = celShadingShader->setPermutation(packet.permutation);
+                break;
+            case RenderShader::EdgeEffect: edgeEffectShader->use(); break;
+            case RenderShader::Sky:        skyShader->use();        break;
+            }
+        }
+    }
+
+    // Un paquet sans texture ni matériau garde ceux déjà liés.
+    if (packet.texture && tracker.texture != packet.texture)
+    {
+        tracker.texture = packet.texture;
+        nChanges++;
+        if (apply)
+            packet.texture->use();
+    }
+    if (packet.cubeMap && tracker.cubeMap != packet.cubeMap)
+    {
+        tracker.cubeMap = packet.cubeMap;
+        nChanges++;
+        if (apply)
+            packet.cubeMap->use();
+    }
+    if (packet.shader == RenderShader::CelShading && (!tracker.hasMaterial || tracker.material != packet.material))
+    {
+        tracker.material = packet.material;
+        tracker.hasMaterial = true;
+        nChanges++;
+        if (apply)
+            materials->use(packet.material);
+    }
+
+    if (tracker.state != packet.state)
+    {
+        if (apply)
+            applyState(tracker.state, packet.state);
+        tracker.state = packet.state;
+        nChanges++;
+    }
+
+    if (packet.shader != RenderShader::Sky && apply)
+    {
+        if (packet.shader == RenderShader::CelShading)
+        {
+            if (tracker.isProgramReady)
+                celShadingShader->setInstanced(packet.isInstanced);
+        }
+        else
+            edgeEffectShader->setInstanced(packet.isInstanced);
+
+        if (!packet.isInstanced && (!tracker.hasDrawId || tracker.drawId != packet.drawId))
+        {
+            transforms->use(packet.drawId);
+            tracker.drawId = packet.drawId;
+            tracker.hasDrawId = true;
+        }
+    }
+
+    return nChanges;
+}
+
+void RenderQueue::applyState(unsigned int previous, unsigned int current)
+{
+    GLStateCache& state = GLStateCache::get();
+    unsigned int changed = previous ^ current;
+
+    const unsigned int STENCIL_FLAGS = STATE_STENCIL_WRITE | STATE_STENCIL_TEST;
+    if (changed & STENCIL_FLAGS)
+    {
+        state.setEnabled(GL_STENCIL_TEST, current & STENCIL_FLAGS);
+        if (current & STATE_STENCIL_WRITE)
+        {
+            state.setStencilFunc(GL_ALWAYS, 2, 0xFF);
+            state.setStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+        }
+        else if (current & STATE_STENCIL_TEST)
+        {
+            state.setStencilFunc(GL_NOTEQUAL, 2, 0xFF);
+            state.setStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        }
+    }
+
+    if (changed & STATE_NO_DEPTH_WRITE)
+        state.setDepthMask(!(current & STATE_NO_DEPTH_WRITE));
+
+    if (changed & STATE_WEIGHTED_BLEND)
+    {
+        state.setEnabled(GL_BLEND, current & STATE_WEIGHTED_BLEND);
+        // Sans glBlendFunci, la même fonction sert aux deux cibles: rgb additionnés (couleur
+        // et poids), alpha multiplié par (1 - alpha) pour le produit des transmittances.
+        if (current & STATE_WEIGHTED_BLEND)
+            state.setBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    if (changed & STATE_NO_CULL)
+        state.setEnabled(GL_CULL_FACE, !(current & STATE_NO_CULL));
+
+    if (changed & STATE_DEPTH_LEQUAL)
+        state.setDepthFunc((current & STATE_DEPTH_LEQUAL) ? GL_LEQUAL : GL_LESS);
+}
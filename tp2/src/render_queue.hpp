@@ -0,0 +1,153 @@
+#pragma once
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "material.hpp"
+
+using namespace gl;
+
+class Model;
+class Texture2D;
+class TextureCubeMap;
+class CelShading;
+class LightManager;
+class EdgeEffect;
+class Sky;
+class TransformRing;
+class TransparencyComposite;
+class WeightedTransparency;
+
+// Ordre d'exécution des passes, bits de poids fort de la clé.
+enum class RenderPass
+{
+    Outlined,           // Objets opaques avec contour, de l'avant vers l'arrière, écrivent le stencil.
+    Opaque,             // Objets opaques sans contour, regroupés par état.
+    Sky,                // Après les opaques: le test de profondeur rejette les pixels déjà couverts.
+    Outline,            // Contours de tous les objets opaques, regroupés par état. Après le ciel,
+                        // qui effacerait les contours qui n'écrivent pas la profondeur.
+    Transparent,        // Dans n'importe quel ordre, regroupés par état (WeightedTransparency).
+    TransparentOutline, // Contours des objets transparents, une fois le stencil de tous écrit.
+};
+
+enum class RenderShader
+{
+    CelShading,
+    EdgeEffect,
+    Sky,
+};
+
+enum RenderStateFlags : unsigned int
+{
+    STATE_STENCIL_WRITE  = 1 << 0, // Écrit 2 dans le stencil.
+    STATE_STENCIL_TEST   = 1 << 1, // Dessine là où le stencil n'est pas 2 (contours).
+    STATE_NO_DEPTH_WRITE = 1 << 2,
+    STATE_WEIGHTED_BLEND = 1 << 3, // Accumulation de WeightedTransparency, passe Transparent seulement.
+    STATE_NO_CULL        = 1 << 4,
+    STATE_DEPTH_LEQUAL   = 1 << 5,
+};
+
+// Tout ce qu'il faut pour exécuter un dessin, indépendamment de l'ordre de soumission.
+struct DrawPacket
+{
+    Model* model;
+    int lod;
+    bool isInstanced; // drawInstanced(), sinon draw(lod) avec les matrices de drawId.
+    GLuint drawId;
+
+    RenderShader shader;
+    Texture2D* texture;
+    TextureCubeMap* cubeMap;
+    MaterialHandle material;
+    unsigned int state; // RenderStateFlags
+    uint32_t permutation; // Variante du programme, choisie par submit() (CelShadingPermutation).
+};
+
+struct RenderQueueStats
+{
+    unsigned int draws;
+    unsigned int stateChanges;          // Changements émis dans l'ordre trié.
+    unsigned int submitOrderChanges;    // Changements qu'aurait demandé l'ordre de soumission.
+    unsigned int programSwitches;
+    unsigned int skippedDraws;          // Variante sans programme prêt qui produise la même image.
+    // Négatif possible: l'ordre trié repart de l'état par défaut après la composition de la transparence.
+    int stateChangesSaved() const { return (int)submitOrderChanges - (int)stateChanges; }
+};
+
+// File de dessins triée une fois par image par une clé de 64 bits:
+//   Outlined: passe | profondeur | ordre de soumission
+//   Autres:   passe | shader | variante | état | texture | matériau | profondeur | ordre
+// Les contours forment leurs propres passes: le nombre de changements de programme par
+// image ne dépend pas du nombre d'objets. L'exécution ne refait que les changements d'état nécessaires.
+class RenderQueue
+{
+public:
+    RenderQueue();
+
+    // maxDepth: distance au-delà de laquelle la profondeur de la clé sature (le plan far).
+    void reset(const glm::vec3& cameraPosition, float maxDepth);
+
+    // Les transformations du dessin doivent déjà être dans le TransformRing et les lumières à jour:
+    // la variante de CelShading dépend de ses projecteurs.
+    void submit(RenderPass pass, const DrawPacket& packet, const glm::vec3& worldPosition);
+    // Dessin qui écrit le stencil dans pass (Outlined ou Transparent) et contour correspondant
+    // dans la passe de contour. edgeState s'ajoute à l'état du contour seulement.
+    void submitOutlined(RenderPass pass, const DrawPacket& packet, unsigned int edgeState, const glm::vec3& worldPosition);
+
+    void sort();
+    // Les matrices communes à l'image doivent déjà être envoyées aux programmes.
+    void execute();
+
+    const RenderQueueStats& getStats() const { return stats_; }
+
+    // Faux quand les contours sont faits en espace écran: submitOutlined ne soumet plus les contours extrudés.
+    bool isEdgeEffectEnabled;
+
+    CelShading* celShadingShader;
+    EdgeEffect* edgeEffectShader;
+    Sky* skyShader;
+    MaterialTable* materials;
+    TransformRing* transforms;
+    LightManager* lights;
+    WeightedTransparency* transparency;
+    TransparencyComposite* transparencyCompositeShader;
+
+private:
+    // État courant vu par la file. Sert à l'exécution et au décompte dans l'ordre de soumission.
+    struct StateTracker
+    {
+        StateTracker();
+
+        int shader;
+        uint32_t permutation;
+        bool isProgramReady; // Faux: les dessins sont sautés jusqu'au prochain changement de programme.
+        Texture2D* texture;
+        TextureCubeMap* cubeMap;
+        MaterialHandle material;
+        bool hasMaterial;
+        unsigned int state;
+        GLuint drawId;
+        bool hasDrawId;
+    };
+
+    uint32_t selectPermutation(const DrawPacket& packet) const;
+    uint64_t makeKey(RenderPass pass, const DrawPacket& packet, float depth) const;
+    // Met tracker à jour pour packet et retourne le nombre de changements d'état.
+    // Les appels OpenGL ne sont faits que si apply est vrai.
+    unsigned int changeState(StateTracker& tracker, const DrawPacket& packet, bool apply);
+    void applyState(unsigned int previous, unsigned int current);
+
+    glm::vec3 cameraPosition_;
+    float maxDepth_;
+
+    std::vector<DrawPacket> packets_;
+    std::vector<uint64_t> keys_;
+    std::vector<uint32_t> order_;
+    std::vector<uint32_t> sortBuffer_;
+    std::vector<uint64_t> keyBuffer_;
+
+    RenderQueueStats stats_;
+};
@@ -0,0 +1,108 @@
+#include "screen_outline.hpp"
+
+#include <iostream>
+
+#include "gl_state.hpp"
+#include "shaders.hpp"
+
+static GLuint createTarget(GLenum internalFormat, GLenum format, GLenum type, GLsizei width, GLsizei height)
+{
+    GLuint id;
+    glGenTextures(1, &id);
+    GLStateCache::get().bindTexture(0, GL_TEXTURE_2D, id);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return id;
+}
+
+ScreenSpaceOutline::ScreenSpaceOutline()
+: fbo_(0), colorTexture_(0), normalTexture_(0), depthTexture_(0), emptyVao_(0)
+, width_(0), height_(0)
+{
+
+}
+
+ScreenSpaceOutline::~ScreenSpaceOutline()
+{
+    release();
+}
+
+void ScreenSpaceOutline::resize(GLsizei width, GLsizei height)
+{
+    if (fbo_ && width == width_ && height == height_)
+        return;
+
+    release();
+    width_ = width;
+    height_ = height;
+
+    colorTexture_ = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    normalTexture_ = createTarget(GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    depthTexture_ = createTarget(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, width, height);
+
+    glGenFramebuffers(1, &fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture_, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture_, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture_, 0);
+
+    const GLenum DRAW_BUFFERS[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, DRAW_BUFFERS);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Screen-space outline framebuffer is incomplete" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenVertexArrays(1, &emptyVao_);
+}
+
+void ScreenSpaceOutline::release()
+{
+    if (!fbo_)
+        return;
+
+    GLStateCache& state = GLStateCache::get();
+    if (emptyVao_)
+        state.bindVertexArray(0);
+
+    // Les textures peuvent être encore liées: le cache ne doit pas croire à un nom réutilisé.
+    state.invalidate();
+
+    glDeleteVertexArrays(1, &emptyVao_);
+    glDeleteFramebuffers(1, &fbo_);
+    glDeleteTextures(1, &colorTexture_);
+    glDeleteTextures(1, &normalTexture_);
+    glDeleteTextures(1, &depthTexture_);
+    emptyVao_ = fbo_ = colorTexture_ = normalTexture_ = depthTexture_ = 0;
+}
+
+void ScreenSpaceOutline::begin()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    // Normale nulle (encodée 0.5) pour les pixels du ciel, qui ne l'écrit pas.
+    const GLfloat NO_NORMAL[] = { 0.5f, 0.5f, 0.5f, 0.0f };
+    glClearBufferfv(GL_COLOR, 1, NO_NORMAL);
+}
+
+void ScreenSpaceOutline::end(EdgeDetection& shader, float near, float far, bool isOutlined)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    GLStateCache& state = GLStateCache::get();
+    state.bindTexture(OUTLINE_COLOR_UNIT, GL_TEXTURE_2D, colorTexture_);
+    state.bindTexture(OUTLINE_NORMAL_UNIT, GL_TEXTURE_2D, normalTexture_);
+    state.bindTexture(OUTLINE_DEPTH_UNIT, GL_TEXTURE_2D, depthTexture_);
+
+    shader.use();
+    shader.setParameters(width_, height_, near, far, isOutlined);
+
+    state.setEnabled(GL_DEPTH_TEST, false);
+    state.bindVertexArray(emptyVao_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    state.setEnabled(GL_DEPTH_TEST, true);
+}
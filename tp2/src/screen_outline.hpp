@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glbinding/gl/gl.h>
+
+using namespace gl;
+
+class EdgeDetection;
+
+// Unités de texture de la passe de composition, l'unité 1 étant celle du TransformRing.
+const GLuint OUTLINE_COLOR_UNIT = 0;
+const GLuint OUTLINE_NORMAL_UNIT = 2;
+const GLuint OUTLINE_DEPTH_UNIT = 3;
+
+// Contours en post-traitement: la scène est dessinée dans un FBO (couleur, normales dans
+// l'espace de vue, profondeur-stencil), puis une seule passe plein écran détecte les
+// discontinuités de profondeur et de normale. Le coût dépend de la résolution et non du
+// nombre d'objets, contrairement aux contours extrudés d'EdgeEffect.
+// La scène passe par ce FBO même sans ces contours: sa profondeur-stencil est partagée avec
+// WeightedTransparency, ce que le framebuffer par défaut (multiéchantillonné) ne permet pas.
+class ScreenSpaceOutline
+{
+public:
+    ScreenSpaceOutline();
+    ~ScreenSpaceOutline();
+
+    // Recrée les attachements si la taille de la fenêtre a changé.
+    void resize(GLsizei width, GLsizei height);
+    void release();
+
+    // Le rendu de la scène qui suit va dans le FBO.
+    void begin();
+    // Copie la couleur dans le framebuffer par défaut, avec les contours si isOutlined.
+    void end(EdgeDetection& shader, float near, float far, bool isOutlined);
+
+    GLuint getDepthStencilTexture() const { return depthTexture_; }
+
+private:
+    GLuint fbo_;
+    GLuint colorTexture_;
+    GLuint normalTexture_;
+    GLuint depthTexture_; // GL_DEPTH24_STENCIL8, les passes de la file écrivent toujours le stencil.
+    GLuint emptyVao_;     // Le triangle plein écran est généré par gl_VertexID.
+    GLsizei width_;
+    GLsizei height_;
+};
@@ -1,9 +1,15 @@
 #include "shader_program.hpp"
 
+#include <bit>
+#include <filesystem>
 #include <iostream>
+#include <string>
 
 #include "inf2705/utils.hpp"
 
+#include "gl_state.hpp"
+#include "program_cache.hpp"
+
 
 static bool checkShaderCompilingError(const char* name, GLuint id)
 {
@@ -42,93 +48,421 @@ static bool checkProgramLinkingError(const char* name, GLuint id)
     return success;
 }
 
+// KHR_parallel_shader_compile (ou son équivalent ARB): les compilations se font sur les fils
+// du pilote et GL_COMPLETION_STATUS_KHR dit si un statut peut être lu sans attendre.
+static bool isParallelShaderCompileSupported()
+{
+    static int isSupported = -1;
+    if (isSupported < 0)
+    {
+        isSupported = 0;
+        GLint nExtensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &nExtensions);
+        for (GLint i = 0; i < nExtensions && !isSupported; i++)
+        {
+            std::string extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            isSupported = extension == "GL_KHR_parallel_shader_compile" || extension == "GL_ARB_parallel_shader_compile";
+        }
+        if (isSupported)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); // Autant de fils que le pilote le veut.
+    }
+    return isSupported;
+}
+
 ShaderProgram::ShaderProgram()
-: id_(0), name_("Uninitialized Name")
+: id_(0), name_("Uninitialized Name"), outputPermutationMask_(0)
+, permutation_(0), isReloadPending_(false)
 {
 
 }
 
 ShaderProgram::~ShaderProgram()
 {
-    glDeleteProgram(id_);
+    for (auto& [permutation, variant] : variants_)
+    {
+        discardPending(permutation, variant);
+        deleteProgram(variant.id);
+    }
+    for (const ShaderStage& stage : shaderStages_)
+    {
+        for (const auto& [stagePermutation, object] : stage.objects)
+            glDeleteShader(object.id);
+    }
 }
 
 void ShaderProgram::create()
 {    
-    id_ = glCreateProgram();
+    isParallelShaderCompileSupported();
     load();
 }
 
 void ShaderProgram::reload()
 {
-    if (!id_)
-        id_ = glCreateProgram();
+    for (ShaderStage& stage : shaderStages_)
+        readStage(stage);
+    startReload();
+}
+
+bool ShaderProgram::reloadChangedFiles(const std::vector<std::string>& paths)
+{
+    bool isChanged = false;
+    for (ShaderStage& stage : shaderStages_)
+    {
+        std::filesystem::path stagePath = std::filesystem::path(stage.path).lexically_normal();
+        for (const std::string& path : paths)
+        {
+            if (std::filesystem::path(path).lexically_normal() == stagePath)
+            {
+                isChanged |= readStage(stage);
+                break;
+            }
+        }
+    }
+
+    if (isChanged)
+        startReload();
+    return isChanged;
+}
+
+bool ShaderProgram::readStage(ShaderStage& stage)
+{
+    std::string code = readFile(stage.path);
+    if (code == stage.code)
+        return false;
+
+    // Un programme en cours de lien qui l'utilise encore le garde jusqu'à sa destruction.
+    stage.code = std::move(code);
+    for (const auto& [stagePermutation, object] : stage.objects)
+        glDeleteShader(object.id);
+    stage.objects.clear();
+    return true;
+}
+
+void ShaderProgram::startReload()
+{
+    // Toutes les variantes connues sont recompilées, y compris celles en échec: leurs sources
+    // ont pu être corrigées. Un rechargement encore en cours est remplacé par celui-ci.
+    variants_.try_emplace(0, Variant{});
+    for (auto& [permutation, variant] : variants_)
+    {
+        discardPending(permutation, variant);
+        submitVariant(permutation, variant);
+    }
+    isReloadPending_ = true;
+}
+
+bool ShaderProgram::isReloading() const
+{
+    for (const auto& [permutation, variant] : variants_)
+    {
+        if (variant.pendingId)
+            return true;
+    }
+    return false;
+}
+
+bool ShaderProgram::pollReload()
+{
+    // Sans l'extension, le statut est lu à l'image suivante: les pilotes qui compilent déjà
+    // en arrière-plan ont eu une image pour le faire.
+    if (!isReloadPending_)
+    {
+        // Premières compilations de variantes, chacune utilisable dès qu'elle est prête.
+        for (auto& [permutation, variant] : variants_)
+        {
+            if (!variant.pendingId || !isVariantComplete(variant))
+                continue;
+            variant.id = finishVariant(permutation, variant);
+            variant.hasFailed = !variant.id;
+            if (variant.id)
+                initializeProgram(variant.id);
+        }
+        return false;
+    }
+
+    // Un rechargement n'est échangé qu'une fois toutes ses variantes terminées, pour ne jamais
+    // mélanger des programmes issus d'anciennes et de nouvelles sources.
+    for (const auto& [permutation, variant] : variants_)
+    {
+        if (variant.pendingId && !isVariantComplete(variant))
+            return false;
+    }
+    isReloadPending_ = false;
+
+    std::map<uint32_t, GLuint> linked;
+    for (auto& [permutation, variant] : variants_)
+        linked[permutation] = variant.pendingId ? finishVariant(permutation, variant) : 0;
+
+    if (!linked[0])
+    {
+        std::cout << "Program \"" << name_ << "\" kept its previous version." << std::endl;
+        for (const auto& [permutation, program] : linked)
+            deleteProgram(program);
+        // Une variante demandée pendant ce rechargement attend le suivant.
+        for (auto& [permutation, variant] : variants_)
+            variant.hasFailed |= !variant.id;
+        return false;
+    }
 
-    for (auto it = shaderSourcesCompiled_.cbegin(); it != shaderSourcesCompiled_.cend(); it++)
+    for (auto& [permutation, variant] : variants_)
     {
-        GLenum type;
-        const std::string& path = it->first;
-        if (path.find("vs") != std::string::npos)
-            type = GL_VERTEX_SHADER;
-        else if (path.find("fs") != std::string::npos)
-            type = GL_FRAGMENT_SHADER;
-        
-        loadShaderSource(type, path.c_str());
+        if (variant.id == id_)
+            id_ = 0;
+        deleteProgram(variant.id);
+        variant.id = linked[permutation];
+        variant.hasFailed = !variant.id;
+        if (variant.id)
+            initializeProgram(variant.id);
     }
-    link();
+    setPermutation(permutation_);
+    return true;
+}
+
+bool ShaderProgram::setPermutation(uint32_t permutation)
+{
+    permutation_ = permutation;
+
+    auto it = variants_.find(permutation);
+    if (it == variants_.end())
+    {
+        it = variants_.try_emplace(permutation, Variant{}).first;
+        submitVariant(permutation, it->second);
+    }
+
+    // Sinon, la variante prête qui retire le plus de code parmi celles qui ne retirent rien
+    // de plus que la variante demandée et qui produisent la même image.
+    GLuint program = it->second.id;
+    int nBestBits = -1;
+    for (auto candidate = variants_.begin(); !program && candidate != variants_.end(); candidate++)
+    {
+        uint32_t other = candidate->first;
+        bool isCompatible = (other & ~permutation) == 0 && ((other ^ permutation) & outputPermutationMask_) == 0;
+        if (candidate->second.id && isCompatible && std::popcount(other) > nBestBits)
+        {
+            nBestBits = std::popcount(other);
+            program = candidate->second.id;
+        }
+    }
+    if (!program)
+        return false;
+
+    activate(program);
+    return true;
 }
 
 void ShaderProgram::use()
 {
-    glUseProgram(id_);
+    GLStateCache::get().useProgram(id_);
 }
 
 
 
 void ShaderProgram::loadShaderSource(GLenum type, const char* path)
 {
-    std::string code = readFile(path);
-    GLuint shaderObject = glCreateShader(type);
-    const char* codePtr = code.c_str();
-    glShaderSource(shaderObject, 1, &codePtr, NULL);
-    glCompileShader(shaderObject);
-    if (checkShaderCompilingError(path, shaderObject))
+    shaderStages_.push_back({ type, path, readFile(path), {} });
+}
+
+void ShaderProgram::addPermutationDefine(const char* name, bool changesOutput)
+{
+    if (changesOutput)
+        outputPermutationMask_ |= 1u << permutationDefines_.size();
+    permutationDefines_.push_back(name);
+}
+
+void ShaderProgram::link()
+{
+    // Compilation synchrone: le programme de base doit exister dès la première image.
+    Variant& base = variants_.try_emplace(0, Variant{}).first->second;
+    submitVariant(0, base);
+    base.id = finishVariant(0, base);
+    base.hasFailed = !base.id;
+    id_ = base.id;
+    if (id_)
+        initializeProgram(id_);
+}
+
+std::string ShaderProgram::getPermutedCode(const std::string& code, uint32_t permutation) const
+{
+    if (!permutation)
+        return code;
+
+    std::string defines;
+    for (size_t i = 0; i < permutationDefines_.size(); i++)
     {
-        glAttachShader(id_, shaderObject);
+        if (permutation & (1u << i))
+            defines += "#define " + permutationDefines_[i] + "\n";
     }
-    else
+
+    size_t insertAt = 0;
+    size_t version = code.find("#version");
+    if (version != std::string::npos)
     {
-        glDeleteShader(shaderObject);
-        shaderObject = 0;
+        size_t lineEnd = code.find('\n', version);
+        insertAt = lineEnd == std::string::npos ? code.size() : lineEnd + 1;
     }
-    
-    shaderSourcesCompiled_[path] = shaderObject;
+    return code.substr(0, insertAt) + defines + code.substr(insertAt);
 }
 
-void ShaderProgram::link()
+uint32_t ShaderProgram::getStagePermutation(const ShaderStage& stage, uint32_t permutation) const
 {
-    glLinkProgram(id_);
-    if (!checkProgramLinkingError(name_, id_))
+    uint32_t used = 0;
+    for (size_t i = 0; i < permutationDefines_.size(); i++)
     {
-        glDeleteProgram(id_);
-        id_ = 0;
+        if (stage.code.find(permutationDefines_[i]) != std::string::npos)
+            used |= 1u << i;
     }
+    return permutation & used;
+}
+
+std::string ShaderProgram::getCacheName(uint32_t permutation) const
+{
+    return permutation ? std::string(name_) + "." + std::to_string(permutation) : std::string(name_);
+}
+
+uint64_t ShaderProgram::computeCacheKey(uint32_t permutation) const
+{
+    uint64_t key = getProgramCacheSeed();
+    for (const ShaderStage& stage : shaderStages_)
+        key = hashProgramSource(key, getPermutedCode(stage.code, getStagePermutation(stage, permutation)));
+    return key;
+}
+
+void ShaderProgram::submitVariant(uint32_t permutation, Variant& variant)
+{
+    variant.pendingId = glCreateProgram();
+    variant.pendingKey = computeCacheKey(permutation);
+    variant.isPendingFromCache = loadCachedProgram(getCacheName(permutation).c_str(), variant.pendingKey, variant.pendingId);
+    if (!variant.isPendingFromCache)
+        submitCompile(variant.pendingId, permutation);
+}
+
+bool ShaderProgram::isVariantComplete(const Variant& variant) const
+{
+    if (variant.isPendingFromCache || !isParallelShaderCompileSupported())
+        return true;
+
+    GLint isComplete = GL_FALSE;
+    glGetProgramiv(variant.pendingId, GL_COMPLETION_STATUS_KHR, &isComplete);
+    return isComplete;
+}
+
+GLuint ShaderProgram::finishVariant(uint32_t permutation, Variant& variant)
+{
+    GLuint program = variant.pendingId;
+    variant.pendingId = 0;
+    std::string cacheName = getCacheName(permutation);
 
-    for (auto it = shaderSourcesCompiled_.cbegin(); it != shaderSourcesCompiled_.cend(); it++)
+    if (!variant.isPendingFromCache && !finishCompile(program, permutation, cacheName.c_str()))
     {
-        if (it->second)
+        glDeleteProgram(program);
+        if (permutation != 0)
+            std::cout << "Program \"" << cacheName << "\" failed, its draws use the closest ready variant or are skipped." << std::endl;
+        return 0;
+    }
+    if (!variant.isPendingFromCache)
+        writeCachedProgram(cacheName.c_str(), variant.pendingKey, program);
+    return program;
+}
+
+void ShaderProgram::discardPending(uint32_t permutation, Variant& variant)
+{
+    if (!variant.pendingId)
+        return;
+
+    for (ShaderStage& stage : shaderStages_)
+    {
+        auto it = stage.objects.find(getStagePermutation(stage, permutation));
+        if (it == stage.objects.end())
+            continue;
+        glDetachShader(variant.pendingId, it->second.id);
+        // Statut jamais lu: l'objet est recompilé à la prochaine soumission.
+        if (it->second.isCompiling)
         {
-            if (id_)
-                glDetachShader(id_, it->second);
-            glDeleteShader(it->second);
+            glDeleteShader(it->second.id);
+            stage.objects.erase(it);
         }
     }
-    
-    if (id_)
+
+    glDeleteProgram(variant.pendingId);
+    variant.pendingId = 0;
+}
+
+void ShaderProgram::submitCompile(GLuint program, uint32_t permutation)
+{
+    for (ShaderStage& stage : shaderStages_)
     {
-        getAllUniformLocations();
-        assignAllUniformBlockIndexes();
+        uint32_t stagePermutation = getStagePermutation(stage, permutation);
+        ShaderObject& object = stage.objects[stagePermutation];
+        if (!object.id)
+        {
+            std::string code = getPermutedCode(stage.code, stagePermutation);
+            const char* codePtr = code.c_str();
+            object.id = glCreateShader(stage.type);
+            glShaderSource(object.id, 1, &codePtr, NULL);
+            glCompileShader(object.id);
+            object.isCompiling = true;
+        }
+        glAttachShader(program, object.id);
     }
+
+    if (isProgramBinarySupported())
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    // Un shader qui ne compile pas fait échouer le lien, l'erreur est rapportée par finishCompile().
+    glLinkProgram(program);
+}
+
+bool ShaderProgram::finishCompile(GLuint program, uint32_t permutation, const char* name)
+{
+    bool success = true;
+    for (ShaderStage& stage : shaderStages_)
+    {
+        auto it = stage.objects.find(getStagePermutation(stage, permutation));
+        if (it == stage.objects.end())
+            continue;
+        glDetachShader(program, it->second.id);
+        if (!it->second.isCompiling)
+            continue;
+
+        it->second.isCompiling = false;
+        if (!checkShaderCompilingError(stage.path.c_str(), it->second.id))
+        {
+            // Recompilé à la prochaine soumission, même si la source ne change pas.
+            glDeleteShader(it->second.id);
+            stage.objects.erase(it);
+            success = false;
+        }
+    }
+    return checkProgramLinkingError(name, program) && success;
+}
+
+void ShaderProgram::initializeProgram(GLuint program)
+{
+    GLuint active = id_;
+    id_ = program;
+    getAllUniformLocations();
+    assignAllUniformBlockIndexes();
+    assignAllTextureUnits();
+    id_ = active;
+}
+
+void ShaderProgram::activate(GLuint program)
+{
+    if (program == id_)
+    {
+        use();
+        return;
+    }
+    id_ = program;
+    use();
+    restoreUniforms();
+}
+
+void ShaderProgram::deleteProgram(GLuint program)
+{
+    if (!program)
+        return;
+    GLStateCache::get().forgetProgram(program);
+    glDeleteProgram(program);
 }
 
 void ShaderProgram::setUniformBlockBinding(const char* name, GLuint bindingIndex)
@@ -137,5 +471,12 @@ void ShaderProgram::setUniformBlockBinding(const char* name, GLuint bindingIndex
     glUniformBlockBinding(id_, blockIndex, bindingIndex);
 }
 
+void ShaderProgram::setTextureUnit(const char* name, GLint unit)
+{
+    // Pas de glProgramUniform en GL 3.3, le programme doit être actif.
+    GLStateCache::get().useProgram(id_);
+    glUniform1i(glGetUniformLocation(id_, name), unit);
+}
+
 
 
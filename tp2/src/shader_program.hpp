@@ -1,7 +1,10 @@
 #include <glbinding/gl/gl.h>
 using namespace gl;
 
-#include <unordered_map>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
 
 
 class ShaderProgram
@@ -11,23 +14,110 @@ public:
     virtual ~ShaderProgram();
     
     void create();
+    // Relit les sources et lance la compilation du programme de base et de toutes les variantes
+    // déjà demandées, sans attendre le pilote. Les anciens programmes restent utilisés jusqu'à
+    // ce que pollReload() les trouve tous liés. Seuls les étages dont la source a changé sont
+    // recompilés, les autres objets de shader sont réutilisés.
     void reload();
+    // Comme reload(), mais seulement si l'un des fichiers modifiés est un étage du programme.
+    bool reloadChangedFiles(const std::vector<std::string>& paths);
+    // À appeler à chaque image: termine les compilations prêtes. Vrai à l'image où un
+    // rechargement remplace l'ancien programme et ses variantes.
+    bool pollReload();
+    bool isReloading() const;
+
+    // Choisit la variante utilisée par use() et la rend active. Une variante jamais demandée est
+    // soumise au pilote sans attendre; d'ici à ce qu'elle soit liée, ou si elle a échoué, la
+    // variante prête la plus proche la remplace. Faux si aucune ne convient: le dessin est à sauter.
+    bool setPermutation(uint32_t permutation);
+    uint32_t getPermutation() const { return permutation_; }
     
     void use();
 
 protected:
+    // Lit la source; la compilation est faite par link(), seulement si le cache de binaires échoue.
     void loadShaderSource(GLenum type, const char* path);
+    // Le i-ème appel donne le nom défini par le bit 1 << i du masque de permutation.
+    // changesOutput: une variante de remplacement doit avoir ce bit dans le même état.
+    void addPermutationDefine(const char* name, bool changesOutput = false);
     void link();
     
     void setUniformBlockBinding(const char* name, GLuint bindingIndex);
+    void setTextureUnit(const char* name, GLint unit);
 
     virtual void load() = 0;
+    // Appelées une fois par programme lié, id_ désignant ce programme. Une classe avec des
+    // variantes garde ses emplacements par programme (id_), plusieurs étant valides à la fois.
     virtual void getAllUniformLocations() = 0;
     virtual void assignAllUniformBlockIndexes() {};
+    virtual void assignAllTextureUnits() {};
+    // id_ vient de changer (autre variante ou rechargement): renvoyer les uniformes dont la
+    // classe garde la valeur et qui diffèrent de ce que ce programme a reçu.
+    virtual void restoreUniforms() {};
+
+private:
+    struct ShaderObject
+    {
+        GLuint id;
+        bool isCompiling; // Statut de compilation pas encore lu.
+    };
+
+    struct ShaderStage
+    {
+        GLenum type;
+        std::string path;
+        std::string code;
+        // Compilés à partir de code, par jeu de #define que la source utilise (voir
+        // getStagePermutation). Vidé quand la source change; absent: à (re)compiler.
+        std::map<uint32_t, ShaderObject> objects;
+    };
+
+    struct Variant
+    {
+        GLuint id;        // Programme lié, 0 si pas encore prêt ou en échec.
+        bool hasFailed;   // La dernière compilation a échoué, la variante n'est plus soumise.
+
+        GLuint pendingId; // Compilation en cours.
+        uint64_t pendingKey;
+        bool isPendingFromCache;
+    };
+
+    // Faux si la source n'a pas changé; sinon les objets de shader de l'étage sont à recompiler.
+    bool readStage(ShaderStage& stage);
+    void startReload();
+    // La directive #version reste en tête, suivie des #define de la permutation.
+    std::string getPermutedCode(const std::string& code, uint32_t permutation) const;
+    // Bits de permutation dont le nom apparaît dans la source: les autres donneraient le même objet.
+    uint32_t getStagePermutation(const ShaderStage& stage, uint32_t permutation) const;
+    std::string getCacheName(uint32_t permutation) const;
+    uint64_t computeCacheKey(uint32_t permutation) const;
+
+    // Soumet la compilation d'une variante sans lire de statut: le pilote peut travailler en parallèle.
+    void submitVariant(uint32_t permutation, Variant& variant);
+    bool isVariantComplete(const Variant& variant) const;
+    // Lit les statuts (attente si le pilote n'a pas fini); pendingId est remis à 0 et son
+    // programme retourné s'il est lié, détruit sinon.
+    GLuint finishVariant(uint32_t permutation, Variant& variant);
+    void discardPending(uint32_t permutation, Variant& variant);
+    // Compile les objets de shader manquants pour la permutation, attache et lie sans lire de statut.
+    void submitCompile(GLuint program, uint32_t permutation);
+    // Lit les statuts (attente si le pilote n'a pas fini) et détache les objets de shader.
+    bool finishCompile(GLuint program, uint32_t permutation, const char* name);
+    // Emplacements, blocs et unités de texture d'un programme qui vient d'être lié.
+    void initializeProgram(GLuint program);
+    void activate(GLuint program);
+    void deleteProgram(GLuint program);
 
 protected:
     GLuint id_;
     const char* name_;
-    std::unordered_map<std::string, GLuint> shaderSourcesCompiled_;
-};
 
+private:
+    std::vector<ShaderStage> shaderStages_;
+    std::vector<std::string> permutationDefines_;
+    uint32_t outputPermutationMask_;
+
+    uint32_t permutation_;
+    std::map<uint32_t, Variant> variants_; // 0: programme de base.
+    bool isReloadPending_; // Les compilations en cours viennent d'un rechargement, à échanger ensemble.
+};
@@ -0,0 +1,120 @@
+#include "shader_watcher.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <system_error>
+
+#ifdef __linux__
+    #include <sys/inotify.h>
+    #include <unistd.h>
+#endif
+
+#ifndef __linux__
+// Intervalle entre deux parcours du répertoire.
+static const std::chrono::milliseconds SCAN_INTERVAL(250);
+#endif
+
+ShaderWatcher::ShaderWatcher()
+#ifdef __linux__
+: fd_(-1)
+#endif
+{
+
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+    release();
+}
+
+bool ShaderWatcher::watch(const char* directory)
+{
+    release();
+    directory_ = directory;
+
+#ifdef __linux__
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    // IN_MOVED_TO: plusieurs éditeurs écrivent un fichier temporaire puis le renomment.
+    if (fd_ < 0 || inotify_add_watch(fd_, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        std::cout << "Could not watch \"" << directory << "\" for shader changes." << std::endl;
+        release();
+        return false;
+    }
+#else
+    // Première lecture des dates: seuls les changements qui suivent sont signalés.
+    poll();
+#endif
+    return true;
+}
+
+void ShaderWatcher::release()
+{
+#ifdef __linux__
+    if (fd_ >= 0)
+        close(fd_);
+    fd_ = -1;
+#else
+    writeTimes_.clear();
+    lastScan_ = {};
+#endif
+}
+
+std::vector<std::string> ShaderWatcher::poll()
+{
+    std::vector<std::string> changes;
+
+#ifdef __linux__
+    if (fd_ < 0)
+        return changes;
+
+    alignas(inotify_event) char buffer[4096];
+    ssize_t size;
+    while ((size = read(fd_, buffer, sizeof(buffer))) > 0)
+    {
+        for (char* p = buffer; p < buffer + size; )
+        {
+            const inotify_event* event = (const inotify_event*)p;
+            if (event->len > 0)
+                addChange(changes, event->name);
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+#else
+    if (directory_.empty())
+        return changes;
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now - lastScan_ < SCAN_INTERVAL)
+        return changes;
+    bool isFirstScan = lastScan_ == std::chrono::steady_clock::time_point();
+    lastScan_ = now;
+
+    std::error_code error;
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory_, error))
+    {
+        if (!entry.is_regular_file(error))
+            continue;
+        std::filesystem::file_time_type writeTime = entry.last_write_time(error);
+        if (error)
+            continue;
+
+        std::string name = entry.path().filename().string();
+        auto it = writeTimes_.find(name);
+        if (it != writeTimes_.end() && it->second == writeTime)
+            continue;
+        writeTimes_[name] = writeTime;
+        if (!isFirstScan)
+            addChange(changes, name);
+    }
+#endif
+
+    return changes;
+}
+
+void ShaderWatcher::addChange(std::vector<std::string>& changes, const std::string& name)
+{
+    std::string path = directory_ + "/" + name;
+    if (std::find(changes.begin(), changes.end(), path) == changes.end())
+        changes.push_back(path);
+}
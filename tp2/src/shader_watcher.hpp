@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Surveille les fichiers d'un répertoire de shaders. Sous Linux, inotify signale les fichiers
+// écrits ou renommés dans le répertoire; ailleurs, les dates de modification sont comparées
+// quelques fois par seconde.
+class ShaderWatcher
+{
+public:
+    ShaderWatcher();
+    ~ShaderWatcher();
+
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    bool watch(const char* directory);
+    void release();
+
+    // Chemins ("répertoire/nom") modifiés depuis l'appel précédent, sans doublons. Ne bloque pas.
+    std::vector<std::string> poll();
+
+private:
+    void addChange(std::vector<std::string>& changes, const std::string& name);
+
+    std::string directory_;
+#ifdef __linux__
+    int fd_;
+#else
+    std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes_;
+    std::chrono::steady_clock::time_point lastScan_;
+#endif
+};
@@ -2,6 +2,11 @@
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include "light_clusters.hpp"
+#include "screen_outline.hpp"
+#include "transform_ring.hpp"
+#include "weighted_transparency.hpp"
+
 
 void EdgeEffect::load()
 {
@@ -16,7 +21,27 @@ void EdgeEffect::load()
 
 void EdgeEffect::getAllUniformLocations()
 {
-	mvpULoc = glGetUniformLocation(id_, "mvp");
+    projViewULoc = glGetUniformLocation(id_, "projView");
+    isInstancedULoc = glGetUniformLocation(id_, "isInstanced");
+    isInstanced_ = -1;
+}
+
+void EdgeEffect::assignAllTextureUnits()
+{
+    setTextureUnit("drawTransforms", TRANSFORM_TEXTURE_UNIT);
+}
+
+void EdgeEffect::setFrameMatrices(glm::mat4& projView)
+{
+    glUniformMatrix4fv(projViewULoc, 1, GL_FALSE, glm::value_ptr(projView));
+}
+
+void EdgeEffect::setInstanced(bool isInstanced)
+{
+    if (isInstanced_ == (GLint)isInstanced)
+        return;
+    glUniform1i(isInstancedULoc, isInstanced);
+    isInstanced_ = isInstanced;
 }
 
 
@@ -38,6 +63,71 @@ void Sky::getAllUniformLocations()
 }
 
 
+void EdgeDetection::load()
+{
+    const char* VERTEX_SRC_PATH = "./shaders/fullscreen.vs.glsl";
+    const char* FRAGMENT_SRC_PATH = "./shaders/edge_detection.fs.glsl";
+
+    name_ = "EdgeDetection";
+    loadShaderSource(GL_VERTEX_SHADER, VERTEX_SRC_PATH);
+    loadShaderSource(GL_FRAGMENT_SHADER, FRAGMENT_SRC_PATH);
+    link();
+}
+
+void EdgeDetection::getAllUniformLocations()
+{
+    texelSizeULoc = glGetUniformLocation(id_, "texelSize");
+    nearULoc = glGetUniformLocation(id_, "near");
+    farULoc = glGetUniformLocation(id_, "far");
+    isOutlinedULoc = glGetUniformLocation(id_, "isOutlined");
+}
+
+void EdgeDetection::assignAllTextureUnits()
+{
+    setTextureUnit("colorTexture", OUTLINE_COLOR_UNIT);
+    setTextureUnit("normalTexture", OUTLINE_NORMAL_UNIT);
+    setTextureUnit("depthTexture", OUTLINE_DEPTH_UNIT);
+}
+
+void EdgeDetection::setParameters(GLsizei width, GLsizei height, float near, float far, bool isOutlined)
+{
+    glUniform2f(texelSizeULoc, 1.0f / width, 1.0f / height);
+    glUniform1f(nearULoc, near);
+    glUniform1f(farULoc, far);
+    glUniform1i(isOutlinedULoc, isOutlined);
+}
+
+
+void TransparencyComposite::load()
+{
+    const char* VERTEX_SRC_PATH = "./shaders/fullscreen.vs.glsl";
+    const char* FRAGMENT_SRC_PATH = "./shaders/transparency_composite.fs.glsl";
+
+    name_ = "TransparencyComposite";
+    loadShaderSource(GL_VERTEX_SHADER, VERTEX_SRC_PATH);
+    loadShaderSource(GL_FRAGMENT_SHADER, FRAGMENT_SRC_PATH);
+    link();
+}
+
+void TransparencyComposite::getAllUniformLocations()
+{
+
+}
+
+void TransparencyComposite::assignAllTextureUnits()
+{
+    setTextureUnit("accumTexture", TRANSPARENCY_ACCUM_UNIT);
+    setTextureUnit("weightTexture", TRANSPARENCY_WEIGHT_UNIT);
+}
+
+
+CelShading::CelShading()
+: isInstanced_(0), projView_(1.0f), view_(1.0f)
+, clusterTileScale_(0.0f), clusterSliceParameters_(0.0f), globalAmbient_(0.0f)
+{
+
+}
+
 void CelShading::load()
 {
     const char* VERTEX_SRC_PATH = "./shaders/phong.vs.glsl";
@@ -46,20 +136,23 @@ void CelShading::load()
     name_ = "CelShading";
     loadShaderSource(GL_VERTEX_SHADER, VERTEX_SRC_PATH);
     loadShaderSource(GL_FRAGMENT_SHADER, FRAGMENT_SRC_PATH);
+    addPermutationDefine("NO_SPOTLIGHTS");
+    addPermutationDefine("DRAW_LIGHTS_ONLY");
+    addPermutationDefine("WEIGHTED_TRANSPARENCY", true);
     link();
 }
 
 void CelShading::getAllUniformLocations()
 {
-    mvpULoc = glGetUniformLocation(id_, "mvp");
-    viewULoc = glGetUniformLocation(id_, "view");
-    modelViewULoc = glGetUniformLocation(id_, "modelView");
-    normalULoc = glGetUniformLocation(id_, "normalMatrix");
-    
-    nSpotLightsULoc = glGetUniformLocation(id_, "nSpotLights");
-    
-    globalAmbientULoc = glGetUniformLocation(id_, "globalAmbient");
-	diffuseSamplerULoc = glGetUniformLocation(id_, "diffuseSampler");
+    // Un identifiant de programme détruit peut être réutilisé: l'entrée repart de zéro.
+    ProgramUniforms& uniforms = programUniforms_[id_];
+    uniforms = {};
+    uniforms.viewULoc = glGetUniformLocation(id_, "view");
+    uniforms.projViewULoc = glGetUniformLocation(id_, "projView");
+    uniforms.isInstancedULoc = glGetUniformLocation(id_, "isInstanced");
+    uniforms.globalAmbientULoc = glGetUniformLocation(id_, "globalAmbient");
+    uniforms.clusterTileScaleULoc = glGetUniformLocation(id_, "clusterTileScale");
+    uniforms.clusterSliceParametersULoc = glGetUniformLocation(id_, "clusterSliceParameters");
 }
 
 void CelShading::assignAllUniformBlockIndexes()
@@ -69,13 +162,69 @@ void CelShading::assignAllUniformBlockIndexes()
 }
 
 
-void CelShading::setMatrices(glm::mat4& mvp, glm::mat4& view, glm::mat4& model)
+void CelShading::assignAllTextureUnits()
 {
-    glm::mat4 modelView = view * model;
-    
-    glUniformMatrix4fv(viewULoc, 1, GL_FALSE, &view[0][0]);
-    glUniformMatrix4fv(mvpULoc, 1, GL_FALSE, &mvp[0][0]);
-    glUniformMatrix4fv(modelViewULoc, 1, GL_FALSE, &modelView[0][0]);
-    glUniformMatrix3fv(normalULoc, 1, GL_TRUE, glm::value_ptr(glm::inverse(glm::mat3(modelView))));
+    setTextureUnit("drawTransforms", TRANSFORM_TEXTURE_UNIT);
+    setTextureUnit("lightGrid", LIGHT_GRID_TEXTURE_UNIT);
+    setTextureUnit("lightIndices", LIGHT_INDEX_TEXTURE_UNIT);
+}
+
+void CelShading::restoreUniforms()
+{
+    sendChangedUniforms();
+}
+
+void CelShading::sendChangedUniforms()
+{
+    auto it = programUniforms_.find(id_);
+    if (it == programUniforms_.end())
+        return;
+    ProgramUniforms& uniforms = it->second;
+
+    if (!uniforms.hasValues || uniforms.view != view_)
+        glUniformMatrix4fv(uniforms.viewULoc, 1, GL_FALSE, &view_[0][0]);
+    if (!uniforms.hasValues || uniforms.projView != projView_)
+        glUniformMatrix4fv(uniforms.projViewULoc, 1, GL_FALSE, &projView_[0][0]);
+    if (!uniforms.hasValues || uniforms.isInstanced != isInstanced_)
+        glUniform1i(uniforms.isInstancedULoc, isInstanced_);
+    if (!uniforms.hasValues || uniforms.clusterTileScale != clusterTileScale_)
+        glUniform2fv(uniforms.clusterTileScaleULoc, 1, glm::value_ptr(clusterTileScale_));
+    if (!uniforms.hasValues || uniforms.clusterSliceParameters != clusterSliceParameters_)
+        glUniform2fv(uniforms.clusterSliceParametersULoc, 1, glm::value_ptr(clusterSliceParameters_));
+    if (!uniforms.hasValues || uniforms.globalAmbient != globalAmbient_)
+        glUniform3fv(uniforms.globalAmbientULoc, 1, glm::value_ptr(globalAmbient_));
+
+    uniforms.hasValues = true;
+    uniforms.view = view_;
+    uniforms.projView = projView_;
+    uniforms.isInstanced = isInstanced_;
+    uniforms.clusterTileScale = clusterTileScale_;
+    uniforms.clusterSliceParameters = clusterSliceParameters_;
+    uniforms.globalAmbient = globalAmbient_;
+}
+
+void CelShading::setFrameMatrices(glm::mat4& projView, glm::mat4& view)
+{
+    projView_ = projView;
+    view_ = view;
+    sendChangedUniforms();
 }
 
+void CelShading::setInstanced(bool isInstanced)
+{
+    isInstanced_ = isInstanced;
+    sendChangedUniforms();
+}
+
+void CelShading::setClusterParameters(const glm::vec2& tileScale, const glm::vec2& sliceParameters)
+{
+    clusterTileScale_ = tileScale;
+    clusterSliceParameters_ = sliceParameters;
+    sendChangedUniforms();
+}
+
+void CelShading::setGlobalAmbient(const glm::vec3& globalAmbient)
+{
+    globalAmbient_ = globalAmbient;
+    sendChangedUniforms();
+}
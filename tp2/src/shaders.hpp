@@ -2,6 +2,8 @@
 
 #include <glm/glm.hpp>
 
+#include <unordered_map>
+
 // Implémentation de vos shaders ici.
 // Ils doivent hérité de ShaderProgram et implémenter les méthodes virtuelles pures
 // load() et getAllUniformLocations().
@@ -22,14 +24,25 @@ protected:
 };
 
 
+// Les matrices par dessin viennent du TransformRing (attribut drawId), les matrices
+// des instances de l'attribut d'instance. Seules les matrices communes à l'image sont des uniforms.
 class EdgeEffect : public ShaderProgram
 {
 public:
-	GLuint mvpULoc;
+    GLuint projViewULoc;
+    GLuint isInstancedULoc;
+
+public:
+    void setFrameMatrices(glm::mat4& projView);
+    void setInstanced(bool isInstanced);
 
 protected:
     virtual void load() override;
     virtual void getAllUniformLocations() override;
+    virtual void assignAllTextureUnits() override;
+
+private:
+    GLint isInstanced_; // -1 tant que l'uniform n'a pas été envoyé depuis le link.
 };
 
 
@@ -45,24 +58,91 @@ protected:
 };
 
 
-class CelShading : public ShaderProgram
+// Détection des contours en espace écran (voir ScreenSpaceOutline).
+class EdgeDetection : public ShaderProgram
 {
 public:
-    GLuint mvpULoc;
-    GLuint viewULoc;
-    GLuint modelViewULoc;
-    GLuint normalULoc;
-    
-	GLuint diffuseSamplerULoc;
-    GLuint nSpotLightsULoc;
-    GLuint globalAmbientULoc;
+    GLuint texelSizeULoc;
+    GLuint nearULoc;
+    GLuint farULoc;
+    GLuint isOutlinedULoc;
 
 public:
-    void setMatrices(glm::mat4& mvp, glm::mat4& view, glm::mat4& model);
+    void setParameters(GLsizei width, GLsizei height, float near, float far, bool isOutlined);
 
 protected:
     virtual void load() override;
     virtual void getAllUniformLocations() override;
-    virtual void assignAllUniformBlockIndexes() override;
+    virtual void assignAllTextureUnits() override;
+};
+
+
+// Composition de la transparence pondérée (voir WeightedTransparency).
+class TransparencyComposite : public ShaderProgram
+{
+protected:
+    virtual void load() override;
+    virtual void getAllUniformLocations() override;
+    virtual void assignAllTextureUnits() override;
+};
+
+
+// Variantes de CelShading, dans l'ordre des #define ajoutés par CelShading::load().
+// Chacune retire du code que le dessin n'exécuterait pas, sauf WEIGHTED_TRANSPARENCY qui change les sorties.
+enum CelShadingPermutation : uint32_t
+{
+    CEL_SHADING_NO_SPOTLIGHTS         = 1 << 0, // Aucun projecteur n'atteint le dessin, seul leur ambiant reste.
+    CEL_SHADING_DRAW_LIGHTS_ONLY      = 1 << 1, // Liste du dessin seulement, sans grille de grappes.
+    CEL_SHADING_WEIGHTED_TRANSPARENCY = 1 << 2, // Sorties vers les cibles de WeightedTransparency.
 };
 
+class CelShading : public ShaderProgram
+{
+public:
+    CelShading();
+
+    void setFrameMatrices(glm::mat4& projView, glm::mat4& view);
+    void setInstanced(bool isInstanced);
+    void setClusterParameters(const glm::vec2& tileScale, const glm::vec2& sliceParameters);
+    void setGlobalAmbient(const glm::vec3& globalAmbient);
+
+protected:
+    virtual void load() override;
+    virtual void getAllUniformLocations() override;
+    virtual void assignAllUniformBlockIndexes() override;
+    virtual void assignAllTextureUnits() override;
+    virtual void restoreUniforms() override;
+
+private:
+    // Emplacements d'un programme lié (base ou variante) et dernières valeurs qu'il a reçues.
+    struct ProgramUniforms
+    {
+        GLint viewULoc;
+        GLint projViewULoc;
+        GLint isInstancedULoc;
+        GLint globalAmbientULoc;
+        GLint clusterTileScaleULoc;
+        GLint clusterSliceParametersULoc;
+
+        bool hasValues; // Faux tant que rien n'a été envoyé depuis le link.
+        GLint isInstanced;
+        glm::mat4 projView;
+        glm::mat4 view;
+        glm::vec2 clusterTileScale;
+        glm::vec2 clusterSliceParameters;
+        glm::vec3 globalAmbient;
+    };
+
+    // Envoie au programme actif les valeurs qui diffèrent de celles qu'il a déjà.
+    void sendChangedUniforms();
+
+    std::unordered_map<GLuint, ProgramUniforms> programUniforms_;
+
+    // Valeurs voulues, communes à toutes les variantes.
+    GLint isInstanced_;
+    glm::mat4 projView_;
+    glm::mat4 view_;
+    glm::vec2 clusterTileScale_;
+    glm::vec2 clusterSliceParameters_;
+    glm::vec3 globalAmbient_;
+};
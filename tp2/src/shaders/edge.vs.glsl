@@ -2,10 +2,48 @@
 
 layout (location = 0) in vec3 position;
 layout (location = 2) in vec3 normal;
+layout (location = 4) in mat4 instanceModel;
+layout (location = 8) in vec2 octNormal;
+layout (location = 9) in vec4 positionScale; // w = 1 pour le format compact.
+layout (location = 10) in vec3 positionOffset;
+layout (location = 11) in uint drawId;
 
-uniform mat4 mvp;
+uniform mat4 projView;
+uniform bool isInstanced;
+
+uniform samplerBuffer drawTransforms;
+
+// Format compact du MeshPool: position quantifiée dans la boîte englobante du maillage
+// et normale en encodage octaédrique.
+vec3 decodePosition(vec3 p)
+{
+    return positionOffset + positionScale.xyz * p;
+}
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// Données par dessin écrites dans le TransformRing: 13 texels RGBA32F par dessin
+// (mvp, modelView, les 3 colonnes de la matrice des normales, puis la liste de projecteurs).
+mat4 fetchMat4(int base)
+{
+    return mat4(texelFetch(drawTransforms, base),
+                texelFetch(drawTransforms, base + 1),
+                texelFetch(drawTransforms, base + 2),
+                texelFetch(drawTransforms, base + 3));
+}
 
 void main()
 {
-    gl_Position = mvp * vec4(position + 0.05 * normal, 1.0);
+    vec3 pos = decodePosition(position);
+    vec3 norm = positionScale.w > 0.5 ? decodeOctahedral(octNormal) : normal;
+
+    mat4 transform = isInstanced ? projView * instanceModel : fetchMat4(int(drawId) * 13);
+    gl_Position = transform * vec4(pos + 0.05 * norm, 1.0);
 }
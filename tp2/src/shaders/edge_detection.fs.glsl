@@ -0,0 +1,64 @@
+#version 330 core
+
+in vec2 texCoords;
+
+out vec4 FragColor;
+
+uniform sampler2D colorTexture;
+uniform sampler2D normalTexture; // Normale dans l'espace de vue, encodée n * 0.5 + 0.5.
+uniform sampler2D depthTexture;
+
+uniform vec2 texelSize;
+uniform float near;
+uniform float far;
+uniform bool isOutlined; // Faux: simple copie de la couleur, les contours sont extrudés par EdgeEffect.
+
+// Seuils de détection: saut de profondeur relatif à la profondeur du pixel, et écart de normales.
+const float DEPTH_THRESHOLD = 0.1;
+const float NORMAL_THRESHOLD = 1.5;
+
+float linearDepth(vec2 uv)
+{
+    float z = texture(depthTexture, uv).r * 2.0 - 1.0;
+    return 2.0 * near * far / (far + near - z * (far - near));
+}
+
+vec3 viewNormal(vec2 uv)
+{
+    return texture(normalTexture, uv).xyz * 2.0 - 1.0;
+}
+
+void main()
+{
+    if (!isOutlined)
+    {
+        FragColor = vec4(texture(colorTexture, texCoords).rgb, 1.0);
+        return;
+    }
+
+    // Filtre de Sobel 3x3 sur la profondeur linéaire et sur les normales.
+    const float KX[9] = float[](-1.0, 0.0, 1.0, -2.0, 0.0, 2.0, -1.0, 0.0, 1.0);
+    const float KY[9] = float[](-1.0, -2.0, -1.0, 0.0, 0.0, 0.0, 1.0, 2.0, 1.0);
+
+    float depthGx = 0.0;
+    float depthGy = 0.0;
+    vec3 normalGx = vec3(0.0);
+    vec3 normalGy = vec3(0.0);
+    for (int i = 0; i < 9; i++)
+    {
+        vec2 uv = texCoords + vec2(i % 3 - 1, i / 3 - 1) * texelSize;
+        float depth = linearDepth(uv);
+        vec3 normal = viewNormal(uv);
+        depthGx += KX[i] * depth;
+        depthGy += KY[i] * depth;
+        normalGx += KX[i] * normal;
+        normalGy += KY[i] * normal;
+    }
+
+    float depthEdge = length(vec2(depthGx, depthGy)) / linearDepth(texCoords);
+    float normalEdge = sqrt(dot(normalGx, normalGx) + dot(normalGy, normalGy));
+    float edge = max(step(DEPTH_THRESHOLD, depthEdge), step(NORMAL_THRESHOLD, normalEdge));
+
+    vec4 color = texture(colorTexture, texCoords);
+    FragColor = vec4(mix(color.rgb, vec3(0.0), edge), 1.0);
+}
@@ -1,7 +1,16 @@
 #version 330 core
 
-#define MAX_SPOT_LIGHTS 9
-#define MAX_POINT_LIGHTS 4
+// Variantes (CelShadingPermutation), définies par ShaderProgram après #version:
+//   NO_SPOTLIGHTS:         aucun projecteur n'atteint le dessin, seul leur terme ambiant reste;
+//   DRAW_LIGHTS_ONLY:      la liste du dessin est valide, la grille de grappes n'est pas lue;
+//   WEIGHTED_TRANSPARENCY: sorties vers les cibles de WeightedTransparency.
+
+#define MAX_SPOT_LIGHTS 128
+
+// Grille de LightClusters.
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
 
 in ATTRIBS_VS_OUT
 {
@@ -13,12 +22,7 @@ in ATTRIBS_VS_OUT
 in LIGHTS_VS_OUT
 {
     vec3 obsPos;
-    vec3 dirLightDir;
-    
-    vec3 spotLightsDir[MAX_SPOT_LIGHTS];
-    vec3 spotLightsSpotDir[MAX_SPOT_LIGHTS];
-    
-    //vec3 pointLightsDir[MAX_POINT_LIGHTS];
+    flat int drawLights;
 } lightsIn;
 
 
@@ -48,9 +52,9 @@ struct SpotLight
     vec3 direction;
     float exponent;
     float openingAngle;
+    float range;
 };
 
-uniform int nSpotLights;
 uniform vec3 globalAmbient;
 
 layout (std140) uniform MaterialBlock
@@ -58,72 +62,133 @@ layout (std140) uniform MaterialBlock
     Material mat;
 };
 
+// Positions et directions dans l'espace de vue, directions normalisées.
 layout (std140) uniform LightingBlock
 {
     DirectionalLight dirLight;
+    vec3 spotAmbient;
     SpotLight spotLights[MAX_SPOT_LIGHTS];
 };
 
 uniform sampler2D diffuseSampler;
 
-out vec4 FragColor;
+uniform samplerBuffer drawTransforms; // Listes de projecteurs par dessin du TransformRing.
+
+uniform usamplerBuffer lightGrid;    // Premier indice et nombre de projecteurs par grappe.
+uniform usamplerBuffer lightIndices;
+uniform vec2 clusterTileScale;       // Tuiles par pixel.
+uniform vec2 clusterSliceParameters; // tranche = log(profondeur) * x + y
+
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 FragNormal; // Lue seulement par les contours en espace écran.
+                                           // Somme des alphas pondérés en transparence pondérée.
 
-float computeSpot(in float openingAngle, in float exponent, in vec3 spotDir, in vec3 lightDir, in vec3 normal)
+#ifndef NO_SPOTLIGHTS
+float computeSpot(in float openingAngle, in float exponent, in float range, in vec3 spotDir, in vec3 lightDir, in vec3 normal)
 {
-    float alpha = dot(normalize(lightDir), normalize(spotDir));
+    float alpha = dot(normalize(lightDir), spotDir);
     float cosAngle = cos(radians(openingAngle));
 
     if (alpha <= cosAngle)
         return 0.0;
 
-    return pow(alpha, exponent);
+    // Fenêtre nulle à la portée, pour que le projecteur n'éclaire pas hors de ses grappes.
+    float window = clamp(1.0 - pow(length(lightDir) / range, 4.0), 0.0, 1.0);
+    return pow(alpha, exponent) * window * window;
+}
+
+uvec2 fetchCluster()
+{
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * clusterTileScale), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+    int slice = clamp(int(log(lightsIn.obsPos.z) * clusterSliceParameters.x + clusterSliceParameters.y), 0, CLUSTER_SLICES - 1);
+    return texelFetch(lightGrid, (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x).xy;
+}
+
+void addSpotLight(in int i, inout vec3 diffuse, inout vec3 specular)
+{
+    // obsPos = -viewPosition
+    vec3 lightDir = spotLights[i].position + lightsIn.obsPos;
+    vec3 spotDir = -spotLights[i].direction;
+
+    float attenuation = computeSpot(
+        spotLights[i].openingAngle,
+        spotLights[i].exponent,
+        spotLights[i].range,
+        spotDir,
+        lightDir,
+        attribsIn.normal
+    );
+
+    if (attenuation <= 0.0f)
+        return;
+
+    vec3 n = normalize(gl_FrontFacing ? attribsIn.normal : -attribsIn.normal);
+    vec3 l = normalize(lightDir);
+    float nl = dot(n, l);
+    if (nl <= 0.0f)
+        return;
+    diffuse += attenuation * mat.diffuse * spotLights[i].diffuse * nl;
+
+    vec3 r = reflect(-l, n);
+    vec3 v = normalize(lightsIn.obsPos);
+    float rv = dot(r, v);
+    if (rv <= 0.0f)
+        return;
+    specular += attenuation * mat.specular * spotLights[i].specular * pow(rv, mat.shininess);
 }
 
 vec3 computeSpotLightsColor(in vec3 texColor)
 {
-    vec3 ambient = vec3(0.0f);
+    vec3 ambient = mat.ambient * spotAmbient;
     vec3 diffuse = vec3(0.0f);
     vec3 specular = vec3(0.0f);
 
-    for (int i = 0; i < nSpotLights; i++)
+#ifdef DRAW_LIGHTS_ONLY
+    vec4 drawLights[2];
+    drawLights[0] = texelFetch(drawTransforms, lightsIn.drawLights);
+    drawLights[1] = texelFetch(drawTransforms, lightsIn.drawLights + 1);
+    int nDrawLights = int(drawLights[0].x);
+    for (int j = 1; j <= nDrawLights; j++)
+        addSpotLight(int(drawLights[j / 4][j % 4]), diffuse, specular);
+#else
+    // Liste du dessin (nombre, puis indices) si elle existe et qu'elle est plus courte que celle de la grappe.
+    uvec2 cluster = fetchCluster();
+    vec4 drawLights[2];
+    int nDrawLights = -1;
+    if (lightsIn.drawLights >= 0)
+    {
+        drawLights[0] = texelFetch(drawTransforms, lightsIn.drawLights);
+        drawLights[1] = texelFetch(drawTransforms, lightsIn.drawLights + 1);
+        nDrawLights = int(drawLights[0].x);
+    }
+
+    if (nDrawLights >= 0 && uint(nDrawLights) <= cluster.y)
+    {
+        for (int j = 1; j <= nDrawLights; j++)
+            addSpotLight(int(drawLights[j / 4][j % 4]), diffuse, specular);
+    }
+    else
     {
-        ambient += mat.ambient * spotLights[i].ambient;
-
-        float attenuation = computeSpot(
-            spotLights[i].openingAngle,
-            spotLights[i].exponent,
-            lightsIn.spotLightsSpotDir[i],
-            lightsIn.spotLightsDir[i],
-            attribsIn.normal
-        );
-
-        if (attenuation <= 0.0f)
-            continue;
-
-        vec3 n = normalize(gl_FrontFacing ? attribsIn.normal : -attribsIn.normal);
-        vec3 l = normalize(lightsIn.spotLightsDir[i]);
-        float nl = dot(n, l);
-        if (nl <= 0.0f)
-            continue;
-        diffuse += attenuation * mat.diffuse * spotLights[i].diffuse * nl;
-
-        vec3 r = reflect(-l, n);
-        vec3 v = normalize(lightsIn.obsPos);
-        float rv = dot(r, v);
-        if (rv <= 0.0f)
-            continue;
-        specular += attenuation * mat.specular * spotLights[i].specular * pow(rv, mat.shininess);
+        for (uint j = 0u; j < cluster.y; j++)
+            addSpotLight(int(texelFetch(lightIndices, int(cluster.x + j)).r), diffuse, specular);
     }
+#endif
 
     return (ambient + diffuse) * texColor + specular;
 }
+#else
+vec3 computeSpotLightsColor(in vec3 texColor)
+{
+    return mat.ambient * spotAmbient * texColor;
+}
+#endif
 
 vec3 computeDirectionalLightColor(in vec3 texColor)
 {
     vec3 ambient = mat.ambient * dirLight.ambient;
 
     vec3 n = normalize(gl_FrontFacing ? attribsIn.normal : -attribsIn.normal);
-    vec3 l = normalize(lightsIn.dirLightDir);
+    vec3 l = -dirLight.direction;
     float nl = dot(n, l);
     if (nl <= 0.0f)
     {
@@ -159,5 +224,16 @@ void main()
 
     fragColor += computeSpotLightsColor(texColor.rgb);
 
+#ifdef WEIGHTED_TRANSPARENCY
+    // Poids décroissant avec la profondeur (équation 10 de McGuire et Bavoil), borné pour
+    // rester dans la précision des cibles RGBA16F.
+    float alpha = texColor.a;
+    float weight = alpha * clamp(0.03 / (1e-5 + pow(lightsIn.obsPos.z / 200.0, 4.0)), 1e-2, 3e3);
+    FragColor = vec4(fragColor * alpha * weight, alpha);
+    FragNormal = vec4(alpha * weight);
+#else
     FragColor = vec4(fragColor, texColor.a);
+    vec3 n = normalize(gl_FrontFacing ? attribsIn.normal : -attribsIn.normal);
+    FragNormal = vec4(n * 0.5 + 0.5, 1.0);
+#endif
 }
@@ -4,9 +4,11 @@ layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 color;
 layout (location = 2) in vec3 normal;
 layout (location = 3) in vec2 texCoords;
-
-#define MAX_SPOT_LIGHTS 9
-#define MAX_POINT_LIGHTS 4
+layout (location = 4) in mat4 instanceModel;
+layout (location = 8) in vec2 octNormal;
+layout (location = 9) in vec4 positionScale; // w = 1 pour le format compact.
+layout (location = 10) in vec3 positionOffset;
+layout (location = 11) in uint drawId;
 
 out ATTRIBS_VS_OUT
 {
@@ -18,18 +20,14 @@ out ATTRIBS_VS_OUT
 out LIGHTS_VS_OUT
 {
     vec3 obsPos;
-    vec3 dirLightDir;
-   
-    vec3 spotLightsDir[MAX_SPOT_LIGHTS];
-    vec3 spotLightsSpotDir[MAX_SPOT_LIGHTS];
-    
-    //vec3 pointLightsDir[MAX_POINT_LIGHTS];
+    flat int drawLights; // Premier texel de la liste de projecteurs du dessin, -1 pour les instances.
 } lightsOut;
 
-uniform mat4 mvp;
 uniform mat4 view;
-uniform mat4 modelView;
-uniform mat3 normalMatrix;
+uniform mat4 projView;
+uniform bool isInstanced;
+
+uniform samplerBuffer drawTransforms;
 
 struct Material
 {
@@ -40,56 +38,71 @@ struct Material
     float shininess;
 };
 
-struct DirectionalLight
+layout (std140) uniform MaterialBlock
 {
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    
-    vec3 direction;
+    Material mat;
 };
 
-struct SpotLight
+// Format compact du MeshPool: position quantifiée dans la boîte englobante du maillage
+// et normale en encodage octaédrique.
+vec3 decodePosition(vec3 p)
 {
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    
-    vec3 position;
-    vec3 direction;
-    float exponent;
-    float openingAngle;
-};
-
-uniform int nSpotLights;
+    return positionOffset + positionScale.xyz * p;
+}
 
-layout (std140) uniform MaterialBlock
+vec3 decodeOctahedral(vec2 e)
 {
-    Material mat;
-};
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
-layout (std140) uniform LightingBlock
+// Données par dessin écrites dans le TransformRing: 13 texels RGBA32F par dessin
+// (mvp, modelView, les 3 colonnes de la matrice des normales, puis la liste de projecteurs).
+mat4 fetchMat4(int base)
 {
-    DirectionalLight dirLight;
-    SpotLight spotLights[MAX_SPOT_LIGHTS];
-};
+    return mat4(texelFetch(drawTransforms, base),
+                texelFetch(drawTransforms, base + 1),
+                texelFetch(drawTransforms, base + 2),
+                texelFetch(drawTransforms, base + 3));
+}
 
 void main()
 {
-    gl_Position = mvp * vec4(position, 1.0);
+    vec3 pos = decodePosition(position);
+    vec3 norm = positionScale.w > 0.5 ? decodeOctahedral(octNormal) : normal;
+
+    mat4 transform;
+    mat4 mv;
+    mat3 nm;
+    if (!isInstanced)
+    {
+        int base = int(drawId) * 13;
+        transform = fetchMat4(base);
+        mv = fetchMat4(base + 4);
+        nm = mat3(texelFetch(drawTransforms, base + 8).xyz,
+                  texelFetch(drawTransforms, base + 9).xyz,
+                  texelFetch(drawTransforms, base + 10).xyz);
+        lightsOut.drawLights = base + 11;
+    }
+    else
+    {
+        transform = projView * instanceModel;
+        mv = view * instanceModel;
+        // Les instances n'ont que des rotations et des mises à l'échelle uniformes,
+        // la normale est renormalisée dans le fragment shader.
+        nm = mat3(mv);
+        lightsOut.drawLights = -1;
+    }
+
+    gl_Position = transform * vec4(pos, 1.0);
     
     attribsOut.texCoords = texCoords;
     attribsOut.color = color;
-    attribsOut.normal = normalMatrix * ((length(normal) <= 0) ? vec3(0.0, 1.0, 0.0) : normal);
+    attribsOut.normal = nm * ((length(norm) <= 0) ? vec3(0.0, 1.0, 0.0) : norm);
 
-    vec3 viewPosition = (modelView * vec4(position, 1.0)).xyz;
+    vec3 viewPosition = (mv * vec4(pos, 1.0)).xyz;
     lightsOut.obsPos = -viewPosition;
-    lightsOut.dirLightDir = mat3(view) * -dirLight.direction;
-  
-    for(int i = 0; i < nSpotLights; i++)
-    {
-        lightsOut.spotLightsDir[i] = (view * vec4(spotLights[i].position, 1.0)).xyz - viewPosition;
-        lightsOut.spotLightsSpotDir[i] = mat3(view) * -spotLights[i].direction;
-    }
-    
 }
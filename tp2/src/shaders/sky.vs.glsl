@@ -1,6 +1,8 @@
 #version 330 core
 
 layout (location = 0) in vec3 position;
+layout (location = 9) in vec4 positionScale;
+layout (location = 10) in vec3 positionOffset;
 
 out vec3 texCoords;
 
@@ -8,6 +10,8 @@ uniform mat4 mvp;
 
 void main()
 {
-    texCoords = position;
-    gl_Position = (mvp * vec4(position, 1.0)).xyww;
+    // Position quantifiée du format compact du MeshPool.
+    vec3 pos = positionOffset + positionScale.xyz * position;
+    texCoords = pos;
+    gl_Position = (mvp * vec4(pos, 1.0)).xyww;
 }
@@ -0,0 +1,18 @@
+#version 330 core
+
+out vec4 FragColor;
+
+uniform sampler2D accumTexture;  // rgb = somme de couleur * alpha * poids, a = produit des (1 - alpha).
+uniform sampler2D weightTexture; // Somme de alpha * poids.
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 accum = texelFetch(accumTexture, texel, 0);
+    float revealage = accum.a;
+    if (revealage >= 1.0)
+        discard;
+
+    float weight = texelFetch(weightTexture, texel, 0).r;
+    FragColor = vec4(accum.rgb / max(weight, 1e-5), 1.0 - revealage);
+}
@@ -3,7 +3,85 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#include <cstring>
 #include <iostream>
+#include <utility>
+#include <vector>
+
+#include "gl_state.hpp"
+
+static GLenum getFormat(int nChannels)
+{
+	switch (nChannels)
+	{
+	    case 1: return GL_RED;
+		case 2: return GL_RG;
+		case 3: return GL_RGB;
+		default: return GL_RGBA;
+	}
+}
+
+//
+// ImageData
+//
+
+ImageData::ImageData()
+: pixels(nullptr), width(0), height(0), nChannels(0)
+{
+
+}
+
+ImageData::ImageData(ImageData&& other)
+: pixels(other.pixels), width(other.width), height(other.height), nChannels(other.nChannels)
+{
+	other.pixels = nullptr;
+}
+
+ImageData& ImageData::operator=(ImageData&& other)
+{
+	std::swap(pixels, other.pixels);
+	width = other.width;
+	height = other.height;
+	nChannels = other.nChannels;
+	return *this;
+}
+
+ImageData::~ImageData()
+{
+	stbi_image_free(pixels);
+}
+
+ImageData decodeImage(const char* path, bool flipVertically)
+{
+	// stbi_set_flip_vertically_on_load() est global dans cette version de stb_image,
+	// on retourne donc l'image nous-mêmes pour pouvoir décoder sur plusieurs threads.
+	ImageData image;
+	image.pixels = stbi_load(path, &image.width, &image.height, &image.nChannels, 0);
+	if (image.pixels == NULL)
+	{
+		std::cout << "Error loading texture \"" << path << "\": " << stbi_failure_reason() << std::endl;
+		return image;
+	}
+
+	if (flipVertically)
+	{
+		size_t rowSize = (size_t)image.width * image.nChannels;
+		std::vector<unsigned char> row(rowSize);
+		for (int y = 0; y < image.height / 2; y++)
+		{
+			unsigned char* top = image.pixels + y * rowSize;
+			unsigned char* bottom = image.pixels + (image.height - 1 - y) * rowSize;
+			memcpy(row.data(), top, rowSize);
+			memcpy(top, bottom, rowSize);
+			memcpy(bottom, row.data(), rowSize);
+		}
+	}
+	return image;
+}
+
+//
+// Texture 2D
+//
 
 Texture2D::Texture2D()
 : m_id(0)
@@ -13,32 +91,18 @@ Texture2D::Texture2D()
 
 void Texture2D::load(const char* path)
 {
-    int width, height, nChannels;
-    stbi_set_flip_vertically_on_load(true);
+	load(decodeImage(path, true));
+}
+
+void Texture2D::load(const ImageData& image)
+{
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    unsigned char* data = stbi_load(path, &width, &height, &nChannels, 0);
-    if (data == NULL)
-        std::cout << "Error loading texture \"" << path << "\": " << stbi_failure_reason() << std::endl;
 
 	glGenTextures(1, &m_id);
-	glBindTexture(GL_TEXTURE_2D, m_id);
-
-	GLenum format;
-	switch (nChannels)
-	{
-	    case 1: format = GL_RED;
-            break;
-		case 2: format = GL_RG;
-			break;
-		case 3: format = GL_RGB;
-			break;
-		case 4: format = GL_RGBA;
-			break;
-	}
+	GLStateCache::get().bindTexture(0, GL_TEXTURE_2D, m_id);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-
-    stbi_image_free(data);
+	GLenum format = getFormat(image.nChannels);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
 }
 
 Texture2D::~Texture2D()
@@ -73,7 +137,7 @@ void Texture2D::enableMipmap()
 
 void Texture2D::use()
 {
-    glBindTexture(GL_TEXTURE_2D, m_id);
+    GLStateCache::get().bindTexture(0, GL_TEXTURE_2D, m_id);
 }
 
 //
@@ -89,37 +153,25 @@ TextureCubeMap::TextureCubeMap()
 void TextureCubeMap::load(const char** pathes)
 {
     const size_t N_TEXTURES = 6;
-    unsigned char* datas[N_TEXTURES];
-    int widths[N_TEXTURES];
-    int heights[N_TEXTURES];
-    int nChannels[N_TEXTURES];
-    stbi_set_flip_vertically_on_load(false);
-    for (unsigned int i = 0; i < 6; i++)
+    ImageData faces[N_TEXTURES];
+    for (unsigned int i = 0; i < N_TEXTURES; i++)
     {
-        datas[i] = stbi_load(pathes[i], &widths[i], &heights[i], &nChannels[i], 0);
-        if (datas[i] == NULL)
-            std::cout << "Error loading texture \"" << pathes[i] << "\": " << stbi_failure_reason() << std::endl;
+        faces[i] = decodeImage(pathes[i], false);
     }
+    load(faces);
+}
+
+void TextureCubeMap::load(const ImageData* faces)
+{
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
 	glGenTextures(1, &m_id);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_id);
+	GLStateCache::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, m_id);
     
     for (unsigned int i = 0; i < 6; i++)
     {
-		GLenum format;
-        switch (nChannels[i])
-        {
-		    case 1: format = GL_RED;
-                break;
-            case 2: format = GL_RG;
-				break;
-			case 3: format = GL_RGB;
-				break;
-			case 4: format = GL_RGBA;
-				break;
-        }
-
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, widths[i], heights[i], 0, format, GL_UNSIGNED_BYTE, datas[i]);
+		GLenum format = getFormat(faces[i].nChannels);
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, faces[i].width, faces[i].height, 0, format, GL_UNSIGNED_BYTE, faces[i].pixels);
     }
 
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -127,12 +179,6 @@ void TextureCubeMap::load(const char** pathes)
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	
-
-    for (unsigned int i = 0; i < 6; i++)
-    {
-        stbi_image_free(datas[i]);
-    }
 }
 
 TextureCubeMap::~TextureCubeMap()
@@ -142,6 +188,6 @@ TextureCubeMap::~TextureCubeMap()
 
 void TextureCubeMap::use()
 {
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_id);
+	GLStateCache::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, m_id);
 }
 
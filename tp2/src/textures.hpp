@@ -5,6 +5,27 @@
 
 using namespace gl;
 
+// Image décodée en mémoire, prête à être envoyée au GPU.
+// Le décodage ne touche pas à OpenGL et peut se faire sur n'importe quel thread.
+struct ImageData
+{
+	ImageData();
+	ImageData(ImageData&& other);
+	ImageData& operator=(ImageData&& other);
+	~ImageData();
+
+	ImageData(const ImageData&) = delete;
+	ImageData& operator=(const ImageData&) = delete;
+
+	unsigned char* pixels;
+	int width;
+	int height;
+	int nChannels;
+};
+
+ImageData decodeImage(const char* path, bool flipVertically);
+
+
 class Texture2D
 {
 public:
@@ -12,6 +33,7 @@ public:
 	~Texture2D();
 	
 	void load(const char* path);
+	void load(const ImageData& image);
 	
 	void setFiltering(GLenum filteringMode);
 	void setWrap(GLenum wrapMode);
@@ -19,6 +41,7 @@ public:
 	void enableMipmap();
 
 	void use();
+	GLuint getId() const { return m_id; }
 
 private:
 	GLuint m_id;
@@ -32,8 +55,10 @@ public:
 	~TextureCubeMap();
 	
 	void load(const char** path);
+	void load(const ImageData* faces);
 
 	void use();
+	GLuint getId() const { return m_id; }
 
 private:
 	GLuint m_id;
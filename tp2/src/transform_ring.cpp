@@ -0,0 +1,133 @@
+#include "transform_ring.hpp"
+
+#include <iostream>
+
+#include "gl_state.hpp"
+
+const GLuint VERTEX_DRAW_ID_INDEX = 11;
+
+TransformRing::TransformRing()
+: buffer_(0), texture_(0), capacity_(0), frame_(0), fences_{}
+, mapped_(nullptr), count_(0)
+{
+
+}
+
+TransformRing::~TransformRing()
+{
+    release();
+}
+
+void TransformRing::create(GLsizei maxDrawsPerFrame)
+{
+    glGenBuffers(1, &buffer_);
+    glGenTextures(1, &texture_);
+    allocate(maxDrawsPerFrame);
+}
+
+void TransformRing::allocate(GLsizei maxDrawsPerFrame)
+{
+    capacity_ = maxDrawsPerFrame;
+    drawLightCounts_.assign(N_FRAMES * capacity_, -1);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer_);
+    glBufferData(GL_TEXTURE_BUFFER, N_FRAMES * capacity_ * sizeof(DrawTransform), nullptr, GL_STREAM_DRAW);
+
+    GLStateCache::get().bindTexture(TRANSFORM_TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture_);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer_);
+}
+
+void TransformRing::release()
+{
+    for (GLsync& fence : fences_)
+    {
+        if (fence)
+            glDeleteSync(fence);
+        fence = 0;
+    }
+    glDeleteTextures(1, &texture_);
+    glDeleteBuffers(1, &buffer_);
+    texture_ = buffer_ = 0;
+}
+
+void TransformRing::beginFrame()
+{
+    // Toutes les sections changent de place: on attend que le GPU les ait toutes lues.
+    // Rare, seulement quand une image a demandé plus de dessins que jamais.
+    if (count_ > capacity_)
+    {
+        std::cout << "Transform ring grown to " << count_ << " draws per frame." << std::endl;
+        for (GLsync& fence : fences_)
+        {
+            if (fence)
+            {
+                glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+                glDeleteSync(fence);
+            }
+            fence = 0;
+        }
+        allocate(count_);
+    }
+
+    // La section a été lue il y a trois images, l'attente est presque toujours nulle.
+    GLsync& fence = fences_[frame_];
+    if (fence)
+    {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer_);
+    mapped_ = (DrawTransform*)glMapBufferRange(GL_TEXTURE_BUFFER, frame_ * capacity_ * sizeof(DrawTransform), capacity_ * sizeof(DrawTransform),
+                                               GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    count_ = 0;
+}
+
+GLuint TransformRing::push(const glm::mat4& mvp, const glm::mat4& view, const glm::mat4& model, const DrawLights& lights)
+{
+    if (count_ >= capacity_)
+    {
+        count_++;
+        return INVALID_DRAW_ID;
+    }
+
+    glm::mat4 modelView = view * model;
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelView)));
+
+    DrawTransform& transform = mapped_[count_];
+    transform.mvp = mvp;
+    transform.modelView = modelView;
+    for (int i = 0; i < 3; i++)
+        transform.normalMatrix[i] = glm::vec4(normalMatrix[i], 0.0f);
+
+    float packed[1 + MAX_DRAW_LIGHTS] = { (float)lights.count };
+    for (int i = 0; i < lights.count; i++)
+        packed[1 + i] = (float)lights.indices[i];
+    transform.lights[0] = glm::vec4(packed[0], packed[1], packed[2], packed[3]);
+    transform.lights[1] = glm::vec4(packed[4], packed[5], packed[6], packed[7]);
+
+    GLuint drawId = frame_ * capacity_ + count_++;
+    drawLightCounts_[drawId] = lights.count;
+    return drawId;
+}
+
+void TransformRing::endWrites()
+{
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer_);
+    glUnmapBuffer(GL_TEXTURE_BUFFER);
+    mapped_ = nullptr;
+
+    GLStateCache::get().bindTexture(TRANSFORM_TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture_);
+}
+
+void TransformRing::endFrame()
+{
+    fences_[frame_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, GL_NONE_BIT);
+    frame_ = (frame_ + 1) % N_FRAMES;
+}
+
+void TransformRing::use(GLuint drawId)
+{
+    GLStateCache::get().setVertexAttribI(VERTEX_DRAW_ID_INDEX, drawId);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "lights.hpp"
+
+using namespace gl;
+
+// Unité de texture réservée au buffer de transformations (les textures des modèles sont sur l'unité 0).
+const GLuint TRANSFORM_TEXTURE_UNIT = 1;
+
+// Retourné par push() quand la section est pleine: le dessin est sauté pour cette image.
+const GLuint INVALID_DRAW_ID = 0xFFFFFFFF;
+
+// Données d'un dessin, lues par texelFetch dans un samplerBuffer RGBA32F.
+struct DrawTransform
+{
+    glm::mat4 mvp;
+    glm::mat4 modelView;
+    glm::vec4 normalMatrix[3]; // mat3 en colonnes, w inutilisé.
+    glm::vec4 lights[2];       // Nombre de projecteurs puis MAX_DRAW_LIGHTS indices, en flottants.
+};
+
+// Anneau de transformations par dessin, en trois sections pour que le CPU écrive l'image
+// suivante pendant que le GPU lit les précédentes. Chaque section est protégée par un GLsync.
+// Sans GL_ARB_buffer_storage (GL 4.4), la section courante est projetée une fois par image
+// en GL_MAP_UNSYNCHRONIZED_BIT: toutes les transformations sont écrites avant les dessins.
+class TransformRing
+{
+public:
+    static const unsigned int N_FRAMES = 3;
+
+    TransformRing();
+    ~TransformRing();
+
+    void create(GLsizei maxDrawsPerFrame);
+    void release();
+
+    void beginFrame();
+    // Retourne l'identifiant de dessin à passer à use(), ou INVALID_DRAW_ID si la section est
+    // pleine. L'anneau est alors agrandi au prochain beginFrame() au nombre de dessins demandés.
+    GLuint push(const glm::mat4& mvp, const glm::mat4& view, const glm::mat4& model, const DrawLights& lights);
+    void endWrites(); // Fin de la projection, le buffer est attaché une seule fois pour l'image.
+    void endFrame();
+
+    // Attribut de vertex constant, valide pour tous les programmes.
+    void use(GLuint drawId);
+
+    // Nombre de projecteurs écrit par push() pour ce dessin, -1 si la liste a débordé.
+    int getDrawLightCount(GLuint drawId) const { return drawLightCounts_[drawId]; }
+
+private:
+    void allocate(GLsizei maxDrawsPerFrame);
+
+    GLuint buffer_;
+    GLuint texture_;
+    GLsizei capacity_;
+    unsigned int frame_;
+    GLsync fences_[N_FRAMES];
+
+    DrawTransform* mapped_;
+    GLsizei count_; // Dessins demandés dans l'image, y compris ceux qui n'ont pas eu de place.
+    std::vector<int> drawLightCounts_; // Copie CPU pour le choix des variantes de CelShading.
+};
@@ -1,6 +1,9 @@
 #include "uniform_buffer.hpp"
 
+#include "gl_state.hpp"
+
 UniformBuffer::UniformBuffer()
+: id_(0)
 {
 }
 
@@ -19,7 +22,12 @@ void UniformBuffer::allocate(const void* data, GLsizeiptr byteSize)
 
 void UniformBuffer::setBindingIndex(GLuint index)
 {
-    glBindBufferBase(GL_UNIFORM_BUFFER, index, id_);
+    GLStateCache::get().bindUniformBuffer(index, id_);
+}
+
+void UniformBuffer::bindRange(GLuint index, GLintptr offset, GLsizeiptr byteSize)
+{
+    GLStateCache::get().bindUniformBufferRange(index, id_, offset, byteSize);
 }
 
 void UniformBuffer::updateData(const void* data, GLintptr offset, GLsizeiptr byteSize)
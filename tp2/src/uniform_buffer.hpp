@@ -14,6 +14,7 @@ public:
     void allocate(const void* data, GLsizeiptr byteSize);
     
     void setBindingIndex(GLuint index);
+    void bindRange(GLuint index, GLintptr offset, GLsizeiptr byteSize);
 
     void updateData(const void* data, GLintptr offset, GLsizeiptr byteSize);
     
@@ -0,0 +1,113 @@
+#include "weighted_transparency.hpp"
+
+#include <iostream>
+
+#include "gl_state.hpp"
+#include "shaders.hpp"
+
+static GLuint createTarget(GLenum internalFormat, GLenum format, GLsizei width, GLsizei height)
+{
+    GLuint id;
+    glGenTextures(1, &id);
+    GLStateCache::get().bindTexture(0, GL_TEXTURE_2D, id);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return id;
+}
+
+WeightedTransparency::WeightedTransparency()
+: fbo_(0), accumTexture_(0), weightTexture_(0), depthStencil_(0), emptyVao_(0)
+, width_(0), height_(0), targetFbo_(0)
+{
+
+}
+
+WeightedTransparency::~WeightedTransparency()
+{
+    release();
+}
+
+void WeightedTransparency::resize(GLsizei width, GLsizei height, GLuint depthStencil)
+{
+    if (fbo_ && width == width_ && height == height_ && depthStencil == depthStencil_)
+        return;
+
+    release();
+    width_ = width;
+    height_ = height;
+    depthStencil_ = depthStencil;
+
+    accumTexture_ = createTarget(GL_RGBA16F, GL_RGBA, width, height);
+    weightTexture_ = createTarget(GL_R16F, GL_RED, width, height);
+
+    glGenFramebuffers(1, &fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumTexture_, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weightTexture_, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthStencil_, 0);
+
+    const GLenum DRAW_BUFFERS[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, DRAW_BUFFERS);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Weighted transparency framebuffer is incomplete" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenVertexArrays(1, &emptyVao_);
+}
+
+void WeightedTransparency::release()
+{
+    if (!fbo_)
+        return;
+
+    GLStateCache& state = GLStateCache::get();
+    if (emptyVao_)
+        state.bindVertexArray(0);
+    state.invalidate();
+
+    glDeleteVertexArrays(1, &emptyVao_);
+    glDeleteFramebuffers(1, &fbo_);
+    glDeleteTextures(1, &accumTexture_);
+    glDeleteTextures(1, &weightTexture_);
+    emptyVao_ = fbo_ = depthStencil_ = accumTexture_ = weightTexture_ = 0;
+}
+
+void WeightedTransparency::begin()
+{
+    GLint target;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+    targetFbo_ = (GLuint)target;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    const GLfloat NO_COVERAGE[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    const GLfloat NO_WEIGHT[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearBufferfv(GL_COLOR, 0, NO_COVERAGE);
+    glClearBufferfv(GL_COLOR, 1, NO_WEIGHT);
+}
+
+void WeightedTransparency::end(TransparencyComposite& shader)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, targetFbo_);
+
+    GLStateCache& state = GLStateCache::get();
+    state.bindTexture(TRANSPARENCY_ACCUM_UNIT, GL_TEXTURE_2D, accumTexture_);
+    state.bindTexture(TRANSPARENCY_WEIGHT_UNIT, GL_TEXTURE_2D, weightTexture_);
+    shader.use();
+
+    // Les normales des contours en espace écran restent celles des surfaces opaques.
+    if (targetFbo_)
+        glColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    state.setEnabled(GL_DEPTH_TEST, false);
+    state.setEnabled(GL_BLEND, true);
+    state.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    state.bindVertexArray(emptyVao_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    state.setEnabled(GL_BLEND, false);
+    state.setEnabled(GL_DEPTH_TEST, true);
+
+    if (targetFbo_)
+        glColorMaski(1, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
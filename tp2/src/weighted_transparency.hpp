@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glbinding/gl/gl.h>
+
+using namespace gl;
+
+class TransparencyComposite;
+
+// Unités de texture de la composition, libres pendant cette passe.
+const GLuint TRANSPARENCY_ACCUM_UNIT = 2;
+const GLuint TRANSPARENCY_WEIGHT_UNIT = 3;
+
+// Transparence indépendante de l'ordre par moyenne pondérée (McGuire et Bavoil, 2013).
+// Les surfaces transparentes sont dessinées dans n'importe quel ordre dans deux cibles:
+//   accum  (RGBA16F): rgb = somme des couleurs prémultipliées et pondérées, a = produit des (1 - alpha);
+//   weight (R16F):    somme des alphas pondérés.
+// Sans glBlendFunci (GL 4.0), une seule fonction de mélange séparée sert aux deux cibles:
+// addition pour rgb, multiplication par (1 - alpha) pour a. Une passe plein écran compose
+// ensuite la moyenne sur l'image opaque.
+class WeightedTransparency
+{
+public:
+    WeightedTransparency();
+    ~WeightedTransparency();
+
+    // depthStencil: texture GL_DEPTH24_STENCIL8 du FBO de la scène, attachée telle quelle. Les
+    // surfaces transparentes testent la profondeur opaque et écrivent le stencil de leurs
+    // contours directement dans celle de la scène, sans copie.
+    void resize(GLsizei width, GLsizei height, GLuint depthStencil);
+    void release();
+
+    // Lie les cibles d'accumulation à la place du framebuffer courant.
+    void begin();
+    // Compose le résultat dans le framebuffer lié au moment de begin().
+    void end(TransparencyComposite& shader);
+
+private:
+    GLuint fbo_;
+    GLuint accumTexture_;
+    GLuint weightTexture_;
+    GLuint depthStencil_; // Texture partagée avec le FBO de la scène, pas détruite ici.
+    GLuint emptyVao_;
+    GLsizei width_;
+    GLsizei height_;
+
+    GLuint targetFbo_; // Framebuffer lié au moment de begin().
+};